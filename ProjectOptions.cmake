@@ -86,6 +86,9 @@ macro(anywho_setup_options)
   # endif()
 
   option(anywho_BUILD_FUZZ_TESTS "Enable fuzz testing executable" ${DEFAULT_FUZZER})
+  option(anywho_BUILD_BENCHMARKS "Enable micro benchmarks against plain std::expected" ON)
+  option(anywho_ENABLE_METRICS "Count errors per id for anywho::metrics::snapshot" OFF)
+  option(anywho_ENABLE_STACKTRACE "Capture the stack errors are created on" OFF)
 
 endmacro()
 
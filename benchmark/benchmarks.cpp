@@ -0,0 +1,763 @@
+#include "anywho.hpp"
+#include "extra.hpp"
+#include "harness.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <expected>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+// Count every allocation so that allocations/op can be reported next to ns/op. Every allocation function is replaced,
+// so that memory of all forms of new is released by the matching delete.
+namespace {
+void *allocate(std::size_t size, std::size_t alignment)
+{
+  anywho::bench::allocation_count.fetch_add(1, std::memory_order_relaxed);
+  if (size == 0) { size = 1; }
+  if (alignment <= alignof(std::max_align_t)) { return std::malloc(size); }
+  return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+void *allocate_or_throw(std::size_t size, std::size_t alignment)
+{
+  if (void *ptr = allocate(size, alignment)) { return ptr; }
+  throw std::bad_alloc{};
+}
+
+// Not inlined, otherwise gcc sees free called on memory from operator new wherever a delete is inlined.
+[[gnu::noinline]] void release(void *ptr) noexcept { std::free(ptr); }
+}// namespace
+
+void *operator new(std::size_t size) { return allocate_or_throw(size, alignof(std::max_align_t)); }
+void *operator new[](std::size_t size) { return allocate_or_throw(size, alignof(std::max_align_t)); }
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+  return allocate_or_throw(size, static_cast<std::size_t>(alignment));
+}
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+  return allocate_or_throw(size, static_cast<std::size_t>(alignment));
+}
+void *operator new(std::size_t size, const std::nothrow_t & /*tag*/) noexcept
+{
+  return allocate(size, alignof(std::max_align_t));
+}
+void *operator new[](std::size_t size, const std::nothrow_t & /*tag*/) noexcept
+{
+  return allocate(size, alignof(std::max_align_t));
+}
+void *operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t & /*tag*/) noexcept
+{
+  return allocate(size, static_cast<std::size_t>(alignment));
+}
+void *operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t & /*tag*/) noexcept
+{
+  return allocate(size, static_cast<std::size_t>(alignment));
+}
+void operator delete(void *ptr) noexcept { release(ptr); }
+void operator delete[](void *ptr) noexcept { release(ptr); }
+void operator delete(void *ptr, std::size_t /*size*/) noexcept { release(ptr); }
+void operator delete[](void *ptr, std::size_t /*size*/) noexcept { release(ptr); }
+void operator delete(void *ptr, std::align_val_t /*alignment*/) noexcept { release(ptr); }
+void operator delete[](void *ptr, std::align_val_t /*alignment*/) noexcept { release(ptr); }
+void operator delete(void *ptr, std::size_t /*size*/, std::align_val_t /*alignment*/) noexcept { release(ptr); }
+void operator delete[](void *ptr, std::size_t /*size*/, std::align_val_t /*alignment*/) noexcept { release(ptr); }
+void operator delete(void *ptr, const std::nothrow_t & /*tag*/) noexcept { release(ptr); }
+void operator delete[](void *ptr, const std::nothrow_t & /*tag*/) noexcept { release(ptr); }
+void operator delete(void *ptr, std::align_val_t /*alignment*/, const std::nothrow_t & /*tag*/) noexcept
+{
+  release(ptr);
+}
+void operator delete[](void *ptr, std::align_val_t /*alignment*/, const std::nothrow_t & /*tag*/) noexcept
+{
+  release(ptr);
+}
+
+namespace {
+
+using FixedError = anywho::FixedSizeError<256>;
+using InlineError = anywho::BasicGenericError<3>;
+using EmptyError = anywho::StaticError<"EmptyError">;
+
+class RowError final : public anywho::WithStaticId<RowError>
+{
+public:
+  static constexpr std::string_view static_message{ "invalid row" };
+};
+
+class ColumnError final : public anywho::WithStaticId<ColumnError>
+{
+public:
+  static constexpr std::string_view static_message{ "invalid column" };
+};
+
+class TableError final : public anywho::WithStaticId<TableError>
+{
+public:
+  static constexpr std::string_view static_message{ "invalid table" };
+};
+
+class EndsError final : public anywho::WithStaticId<EndsError>
+{
+public:
+  static constexpr std::string_view static_message{ "bounded error" };
+  static constexpr anywho::ContextPolicy context_policy{ anywho::ContextPolicy::keep_ends(4, 4) };
+};
+
+class CollapsedError final : public anywho::WithStaticId<CollapsedError>
+{
+public:
+  static constexpr std::string_view static_message{ "collapsed error" };
+  static constexpr anywho::ContextPolicy context_policy{ anywho::ContextPolicy::keep_ends(4, 4).collapsed() };
+};
+
+template<typename E> E make_leaf_error();
+template<> anywho::GenericError make_leaf_error() { return anywho::GenericError{}; }
+template<> FixedError make_leaf_error() { return FixedError{}; }
+template<> InlineError make_leaf_error() { return InlineError{}; }
+template<> RowError make_leaf_error() { return RowError{}; }
+template<> EmptyError make_leaf_error() { return EmptyError{}; }
+template<> EndsError make_leaf_error() { return EndsError{}; }
+template<> CollapsedError make_leaf_error() { return CollapsedError{}; }
+template<> anywho::ErrorFromCode make_leaf_error()
+{
+  return anywho::ErrorFromCode{ std::make_error_code(std::errc::invalid_argument) };
+}
+
+template<> anywho::Error make_leaf_error() { return anywho::Error{ anywho::GenericError{} }; }
+
+template<typename E> const char *error_name();
+template<> const char *error_name<anywho::GenericError>() { return "GenericError"; }
+template<> const char *error_name<FixedError>() { return "FixedSizeError"; }
+template<> const char *error_name<InlineError>() { return "BasicGenericError3"; }
+template<> const char *error_name<RowError>() { return "RowError"; }
+template<> const char *error_name<EmptyError>() { return "StaticError"; }
+template<> const char *error_name<EndsError>() { return "EndsError"; }
+template<> const char *error_name<CollapsedError>() { return "CollapsedError"; }
+template<> const char *error_name<anywho::ErrorFromCode>() { return "ErrorFromCode"; }
+template<> const char *error_name<anywho::Error>() { return "Error"; }
+
+template<typename E> [[gnu::noinline]] std::expected<int, E> leaf(bool fail)
+{
+  if (fail) { return std::unexpected(make_leaf_error<E>()); }
+  return 1;
+}
+
+// Hand-written std::expected propagation, this is what anywho has to be measured against.
+template<typename E> [[gnu::noinline]] std::expected<int, E> expected_chain(int depth, bool fail)
+{
+  if (depth == 0) { return leaf<E>(fail); }
+  auto result = expected_chain<E>(depth - 1, fail);
+  if (!result.has_value()) { return std::unexpected(std::move(result.error())); }
+  return *result + 1;
+}
+
+template<typename E> [[gnu::noinline]] std::expected<int, E> anywho_chain(int depth, bool fail)
+{
+  if (depth == 0) { return leaf<E>(fail); }
+  const int val = ANYWHO(anywho_chain<E>(depth - 1, fail));
+  return val + 1;
+}
+
+// Same chain as a coroutine, propagating with co_await instead of the macro.
+template<typename E> [[gnu::noinline]] std::expected<int, E> coroutine_chain(int depth, bool fail)
+{
+  if (depth == 0) { co_return co_await leaf<E>(fail); }
+  const int val = co_await coroutine_chain<E>(depth - 1, fail);
+  co_return val + 1;
+}
+
+template<typename E> [[gnu::noinline]] std::expected<int, E> expected_context_chain(int depth, bool fail)
+{
+  if (depth == 0) { return leaf<E>(fail); }
+  auto result = expected_context_chain<E>(depth - 1, fail);
+  if (!result.has_value()) {
+    auto err = std::move(result.error());
+    err.consume_context(anywho::Context{ "propagating" });
+    return std::unexpected(std::move(err));
+  }
+  return *result + 1;
+}
+
+template<typename E> [[gnu::noinline]] std::expected<int, E> with_context_chain(int depth, bool fail)
+{
+  if (depth == 0) { return leaf<E>(fail); }
+  const int val = ANYWHO(anywho::with_context(with_context_chain<E>(depth - 1, fail), { "propagating" }));
+  return val + 1;
+}
+
+template<typename E> [[gnu::noinline]] std::expected<int, E> scoped_context_chain(int depth, bool fail)
+{
+  if (depth == 0) { return leaf<E>(fail); }
+  const anywho::ScopedContext guard{ "propagating" };
+  const int val = ANYWHO(scoped_context_chain<E>(depth - 1, fail));
+  return val + 1;
+}
+
+// Formats the context message up front, like with_context(exp, { std::format(...) }) does.
+template<typename E> [[gnu::noinline]] std::expected<int, E> eager_format_chain(int depth, bool fail)
+{
+  if (depth == 0) { return leaf<E>(fail); }
+  const int val = ANYWHO(
+    anywho::with_context(eager_format_chain<E>(depth - 1, fail), { anywho::format_ns::format("level {}", depth) }));
+  return val + 1;
+}
+
+template<typename E> [[gnu::noinline]] std::expected<int, E> lazy_format_chain(int depth, bool fail)
+{
+  if (depth == 0) { return leaf<E>(fail); }
+  const int val = ANYWHO(anywho::with_context_fmt(lazy_format_chain<E>(depth - 1, fail), "level {}", depth));
+  return val + 1;
+}
+
+template<typename E> [[gnu::noinline]] anywho::ErrorState<E> expected_to_optional(int depth, bool fail, int &out)
+{
+  auto result = expected_chain<E>(depth, fail);
+  if (!result.has_value()) { return std::make_optional(std::move(result.error())); }
+  out = *result;
+  return anywho::NoError;
+}
+
+template<typename E> [[gnu::noinline]] anywho::ErrorState<E> anywho_opt(int depth, bool fail, int &out)
+{
+  out = ANYWHO_OPT(expected_chain<E>(depth, fail));
+  return anywho::NoError;
+}
+
+[[gnu::noinline]] bool legacy_square(bool fail, int &output)
+{
+  if (fail) { return false; }
+  output = 9;
+  return true;
+}
+
+[[gnu::noinline]] std::error_code legacy_square_with_code(bool fail, int &output)
+{
+  if (fail) { return std::make_error_code(std::errc::result_out_of_range); }
+  output = 9;
+  return {};
+}
+
+[[gnu::noinline]] int legacy_parse(bool fail)
+{
+  if (fail) { throw std::runtime_error("unexpected token in input"); }
+  return 9;
+}
+
+const char *path_name(bool fail) { return fail ? "error" : "happy"; }
+
+std::string bench_name(const char *group, const char *variant, const char *error, bool fail, int depth)
+{
+  return anywho::format_ns::format("{}/{}/{}/{}/d{}", group, variant, error, path_name(fail), depth);
+}
+
+template<typename E> void add_propagation(anywho::bench::Suite &suite, bool fail, int depth)
+{
+  const auto reference = bench_name("propagate", "expected", error_name<E>(), fail, depth);
+  suite.add(reference, "", [=] {
+    anywho::bench::do_not_optimize(expected_chain<E>(depth, anywho::bench::opaque(fail)));
+  });
+  suite.add(bench_name("propagate", "ANYWHO", error_name<E>(), fail, depth), reference, [=] {
+    anywho::bench::do_not_optimize(anywho_chain<E>(depth, anywho::bench::opaque(fail)));
+  });
+  suite.add(bench_name("propagate", "co_await", error_name<E>(), fail, depth), reference, [=] {
+    anywho::bench::do_not_optimize(coroutine_chain<E>(depth, anywho::bench::opaque(fail)));
+  });
+}
+
+template<typename E> void add_with_context(anywho::bench::Suite &suite, bool fail, int depth)
+{
+  const auto reference = bench_name("context", "expected", error_name<E>(), fail, depth);
+  suite.add(reference, "", [=] {
+    anywho::bench::do_not_optimize(expected_context_chain<E>(depth, anywho::bench::opaque(fail)));
+  });
+  suite.add(bench_name("context", "with_context", error_name<E>(), fail, depth), reference, [=] {
+    anywho::bench::do_not_optimize(with_context_chain<E>(depth, anywho::bench::opaque(fail)));
+  });
+  suite.add(bench_name("context", "ScopedContext", error_name<E>(), fail, depth), reference, [=] {
+    anywho::bench::do_not_optimize(scoped_context_chain<E>(depth, anywho::bench::opaque(fail)));
+  });
+}
+
+// A deep failure with a context per hop, then formatted: bounded chains keep both the propagation and the format cost
+// flat.
+template<typename E> void add_context_policy(anywho::bench::Suite &suite, const std::string &reference, int depth)
+{
+  suite.add(bench_name("bounded", "with_context", error_name<E>(), true, depth), reference, [=] {
+    anywho::bench::do_not_optimize(with_context_chain<E>(depth, anywho::bench::opaque(true)).error().format());
+  });
+}
+
+void add_context_policies(anywho::bench::Suite &suite, int depth)
+{
+  const auto reference = bench_name("bounded", "with_context", error_name<RowError>(), true, depth);
+  suite.add(reference, "", [=] {
+    anywho::bench::do_not_optimize(with_context_chain<RowError>(depth, anywho::bench::opaque(true)).error().format());
+  });
+  add_context_policy<EndsError>(suite, reference, depth);
+  add_context_policy<CollapsedError>(suite, reference, depth);
+}
+
+template<typename E> void add_lazy_context(anywho::bench::Suite &suite, bool fail, int depth)
+{
+  const auto reference = bench_name("context", "eager_format", error_name<E>(), fail, depth);
+  suite.add(reference, "", [=] {
+    anywho::bench::do_not_optimize(eager_format_chain<E>(depth, anywho::bench::opaque(fail)));
+  });
+  suite.add(bench_name("context", "with_context_fmt", error_name<E>(), fail, depth), reference, [=] {
+    anywho::bench::do_not_optimize(lazy_format_chain<E>(depth, anywho::bench::opaque(fail)));
+  });
+}
+
+template<typename E> void add_optional(anywho::bench::Suite &suite, bool fail, int depth)
+{
+  const auto reference = bench_name("optional", "expected", error_name<E>(), fail, depth);
+  suite.add(reference, "", [=] {
+    int out = 0;
+    anywho::bench::do_not_optimize(expected_to_optional<E>(depth, anywho::bench::opaque(fail), out));
+    anywho::bench::do_not_optimize(out);
+  });
+  suite.add(bench_name("optional", "ANYWHO_OPT", error_name<E>(), fail, depth), reference, [=] {
+    int out = 0;
+    anywho::bench::do_not_optimize(anywho_opt<E>(depth, anywho::bench::opaque(fail), out));
+    anywho::bench::do_not_optimize(out);
+  });
+}
+
+template<typename E> void add_format(anywho::bench::Suite &suite, int depth)
+{
+  E error = make_leaf_error<E>();
+  for (int i = 0; i < depth; ++i) { error.consume_context(anywho::Context{ "propagating" }); }
+
+  // Reference is string concatenation, which is how errors were formatted before format_to existed.
+  const auto reference = bench_name("format", "concat", error_name<E>(), true, depth);
+  suite.add(reference, "", [error] {
+    std::string out = error.message();
+    for (const auto &el : error.contexts()) { out += "::" + el.format(); }
+    anywho::bench::do_not_optimize(out);
+  });
+  suite.add(bench_name("format", "format", error_name<E>(), true, depth), reference, [error] {
+    anywho::bench::do_not_optimize(error.format());
+  });
+  suite.add(bench_name("format", "format_to", error_name<E>(), true, depth), reference, [error] {
+    static std::string buffer;
+    buffer.clear();
+    error.format_to(std::back_inserter(buffer));
+    anywho::bench::do_not_optimize(buffer);
+  });
+}
+
+// id() of an error from a code, hashing the message was how it was computed before.
+void add_id(anywho::bench::Suite &suite)
+{
+  const auto error = make_leaf_error<anywho::ErrorFromCode>();
+  const auto reference = bench_name("id", "hash_message", error_name<anywho::ErrorFromCode>(), true, 1);
+  suite.add(reference, "", [error] { anywho::bench::do_not_optimize(anywho::hash_id(error.message())); });
+  suite.add(bench_name("id", "id", error_name<anywho::ErrorFromCode>(), true, 1), reference, [error] {
+    anywho::bench::do_not_optimize(error.id());
+  });
+}
+
+// Dispatch over count errors of four types, the way a caller sorts errors it got back.
+int classify_cast(const anywho::GenericError &error)
+{
+  if (dynamic_cast<const RowError *>(&error) != nullptr) { return 1; }
+  if (dynamic_cast<const ColumnError *>(&error) != nullptr) { return 2; }
+  if (dynamic_cast<const TableError *>(&error) != nullptr) { return 3; }
+  if (const auto *code = dynamic_cast<const anywho::ErrorFromCode *>(&error)) { return code->get_code().value(); }
+  return 0;
+}
+
+template<typename Err> int classify_match(const Err &error)
+{
+  return anywho::match(
+    error,
+    [](const RowError &) { return 1; },
+    [](const ColumnError &) { return 2; },
+    [](const TableError &) { return 3; },
+    [](const anywho::ErrorFromCode &code) { return code.get_code().value(); },
+    [] { return 0; });
+}
+
+void add_match(anywho::bench::Suite &suite, int count)
+{
+  std::vector<std::shared_ptr<const anywho::GenericError>> errors;
+  std::vector<std::shared_ptr<const anywho::Error>> erased;
+  for (int i = 0; i < count; ++i) {
+    switch (i % 4) {
+    case 0:
+      errors.push_back(std::make_shared<RowError>());
+      erased.push_back(std::make_shared<anywho::Error>(RowError{}));
+      break;
+    case 1:
+      errors.push_back(std::make_shared<ColumnError>());
+      erased.push_back(std::make_shared<anywho::Error>(ColumnError{}));
+      break;
+    case 2:
+      errors.push_back(std::make_shared<TableError>());
+      erased.push_back(std::make_shared<anywho::Error>(TableError{}));
+      break;
+    default:
+      errors.push_back(std::make_shared<anywho::ErrorFromCode>(make_leaf_error<anywho::ErrorFromCode>()));
+      erased.push_back(std::make_shared<anywho::Error>(make_leaf_error<anywho::ErrorFromCode>()));
+      break;
+    }
+  }
+
+  const auto reference = bench_name("match", "dynamic_cast", error_name<anywho::GenericError>(), true, count);
+  suite.add(reference, "", [errors] {
+    int sum = 0;
+    for (const auto &error : errors) { sum += classify_cast(*error); }
+    anywho::bench::do_not_optimize(sum);
+  });
+  suite.add(bench_name("match", "match", error_name<anywho::GenericError>(), true, count), reference, [errors] {
+    int sum = 0;
+    for (const auto &error : errors) { sum += classify_match(*error); }
+    anywho::bench::do_not_optimize(sum);
+  });
+  suite.add(bench_name("match", "is", error_name<anywho::GenericError>(), true, count), reference, [errors] {
+    int sum = 0;
+    for (const auto &error : errors) { sum += anywho::is<TableError>(*error) ? 1 : 0; }
+    anywho::bench::do_not_optimize(sum);
+  });
+  suite.add(bench_name("match", "match", error_name<anywho::Error>(), true, count), reference, [erased] {
+    int sum = 0;
+    for (const auto &error : erased) { sum += classify_match(*error); }
+    anywho::bench::do_not_optimize(sum);
+  });
+}
+
+// Batch validation: every one of count rows fails with the same error and contexts.
+template<typename E> void add_collect(anywho::bench::Suite &suite, int count)
+{
+  E error = make_leaf_error<E>();
+  error.consume_context(anywho::Context{ "validating row" });
+  error.consume_context(anywho::Context{ "loading table" });
+
+  const auto reference = bench_name("collect", "vector", error_name<E>(), true, count);
+  suite.add(reference, "", [error, count] {
+    std::vector<E> errors;
+    for (int i = 0; i < count; ++i) { errors.push_back(error); }
+    anywho::bench::do_not_optimize(errors);
+  });
+  suite.add(bench_name("collect", "ErrorList", error_name<E>(), true, count), reference, [error, count] {
+    anywho::ErrorList errors;
+    for (int i = 0; i < count; ++i) { errors.push(error); }
+    anywho::bench::do_not_optimize(errors);
+  });
+}
+
+[[gnu::noinline]] std::expected<int, RowError> square_row(int row)
+{
+  if (row < 0) { return std::unexpected(RowError{}); }
+  return row * row;
+}
+
+// try_transform over count elements against a hand-written loop, the last element fails on the error path.
+void add_transform(anywho::bench::Suite &suite, bool fail, int count)
+{
+  std::vector<int> rows(static_cast<std::size_t>(count), 3);
+  if (fail) { rows.back() = -1; }
+
+  const auto reference = bench_name("transform", "loop", "RowError", fail, count);
+  suite.add(reference, "", [rows] {
+    std::expected<std::vector<int>, RowError> out{ std::in_place };
+    out->reserve(rows.size());
+    for (const int row : rows) {
+      auto result = square_row(row);
+      if (!result.has_value()) {
+        out = std::unexpected(std::move(result.error()));
+        break;
+      }
+      out->push_back(*result);
+    }
+    anywho::bench::do_not_optimize(out);
+  });
+  suite.add(bench_name("transform", "seq", "RowError", fail, count), reference, [rows] {
+    anywho::bench::do_not_optimize(anywho::try_transform(anywho::execution::seq, rows, square_row));
+  });
+  suite.add(bench_name("transform", "par", "RowError", fail, count), reference, [rows] {
+    anywho::bench::do_not_optimize(anywho::try_transform(anywho::execution::par, rows, square_row));
+  });
+}
+
+void add_factories(anywho::bench::Suite &suite, bool fail)
+{
+  {
+    const auto reference = bench_name("factory", "try_catch", "exception", fail, 1);
+    suite.add(reference, "", [=] {
+      std::expected<int, anywho::GenericError> exp{};
+      try {
+        exp = legacy_parse(anywho::bench::opaque(fail));
+      } catch (const std::runtime_error &) {
+        exp = std::unexpected(anywho::GenericError{});
+      }
+      anywho::bench::do_not_optimize(exp);
+    });
+    suite.add(bench_name("factory", "make_error_from_throwable", "exception", fail, 1), reference, [=] {
+      std::expected<int, anywho::ErrorFromException> exp =
+        anywho::make_error_from_throwable<int, std::invalid_argument, std::runtime_error>(
+          [fail] { return legacy_parse(anywho::bench::opaque(fail)); });
+      anywho::bench::do_not_optimize(exp);
+    });
+  }
+  {
+    const auto reference = bench_name("factory", "expected", "bool", fail, 1);
+    suite.add(reference, "", [=] {
+      int output = 0;
+      const bool success = legacy_square(anywho::bench::opaque(fail), output);
+      std::expected<int, anywho::GenericError> exp =
+        success ? std::expected<int, anywho::GenericError>{ output } : std::unexpected(anywho::GenericError{});
+      anywho::bench::do_not_optimize(exp);
+    });
+    suite.add(bench_name("factory", "make_error", "bool", fail, 1), reference, [=] {
+      int output = 0;
+      const bool success = legacy_square(anywho::bench::opaque(fail), output);
+      std::expected<int, anywho::GenericError> exp = anywho::make_error(success, output, anywho::GenericError{});
+      anywho::bench::do_not_optimize(exp);
+    });
+    suite.add(bench_name("factory", "make_error_lazy", "bool", fail, 1), reference, [=] {
+      int output = 0;
+      const bool success = legacy_square(anywho::bench::opaque(fail), output);
+      std::expected<int, anywho::GenericError> exp =
+        anywho::make_error(success, output, [] { return anywho::GenericError{}; });
+      anywho::bench::do_not_optimize(exp);
+    });
+    suite.add(bench_name("factory", "make_error_callable", "bool", fail, 1), reference, [=] {
+      std::expected<int, anywho::GenericError> exp = anywho::make_error(
+        [fail]() {
+          int output = 0;
+          const bool success = legacy_square(anywho::bench::opaque(fail), output);
+          return std::make_tuple(success, output);
+        },
+        anywho::GenericError{});
+      anywho::bench::do_not_optimize(exp);
+    });
+  }
+  {
+    const auto reference = bench_name("factory", "expected", "error_code", fail, 1);
+    suite.add(reference, "", [=] {
+      int output = 0;
+      const std::error_code code = legacy_square_with_code(anywho::bench::opaque(fail), output);
+      std::expected<int, anywho::ErrorFromCode> exp =
+        code ? std::unexpected(anywho::ErrorFromCode{ code }) : std::expected<int, anywho::ErrorFromCode>{ output };
+      anywho::bench::do_not_optimize(exp);
+    });
+    suite.add(bench_name("factory", "make_error", "error_code", fail, 1), reference, [=] {
+      int output = 0;
+      const std::error_code code = legacy_square_with_code(anywho::bench::opaque(fail), output);
+      std::expected<int, anywho::ErrorFromCode> exp = anywho::make_error(code, output);
+      anywho::bench::do_not_optimize(exp);
+    });
+    suite.add(bench_name("factory", "make_error_callable", "error_code", fail, 1), reference, [=] {
+      std::expected<int, anywho::ErrorFromCode> exp = anywho::make_error([fail]() {
+        int output = 0;
+        const std::error_code code = legacy_square_with_code(anywho::bench::opaque(fail), output);
+        return std::make_tuple(code, output);
+      });
+      anywho::bench::do_not_optimize(exp);
+    });
+  }
+}
+
+anywho::bench::Suite make_suite()
+{
+  anywho::bench::Suite suite;
+  for (const bool fail : { false, true }) {
+    for (const int depth : { 1, 8, 64 }) {
+      add_propagation<anywho::GenericError>(suite, fail, depth);
+      add_propagation<FixedError>(suite, fail, depth);
+      add_propagation<anywho::ErrorFromCode>(suite, fail, depth);
+      add_propagation<EmptyError>(suite, fail, depth);
+      add_propagation<anywho::Error>(suite, fail, depth);
+      add_with_context<anywho::GenericError>(suite, fail, depth);
+      add_with_context<FixedError>(suite, fail, depth);
+      add_with_context<InlineError>(suite, fail, depth);
+      add_lazy_context<anywho::GenericError>(suite, fail, depth);
+      add_optional<anywho::GenericError>(suite, fail, depth);
+    }
+    add_factories(suite, fail);
+  }
+  for (const int depth : { 1, 8, 64 }) {
+    add_format<anywho::GenericError>(suite, depth);
+    add_format<InlineError>(suite, depth);
+    add_format<anywho::ErrorFromCode>(suite, depth);
+  }
+  add_id(suite);
+  add_match(suite, 1000);
+  for (const int depth : { 64, 1000 }) { add_context_policies(suite, depth); }
+  add_collect<anywho::GenericError>(suite, 1000);
+  add_collect<RowError>(suite, 1000);
+  for (const bool fail : { false, true }) { add_transform(suite, fail, 10000); }
+  return suite;
+}
+
+struct Options
+{
+  std::string json_path;
+  std::string baseline_path;
+  std::string filter;
+  bool check_timing{ false };
+  bool update_baseline{ false };
+  double tolerance{ 1.5 };
+};
+
+std::optional<Options> parse_options(int argc, char **argv)
+{
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg{ argv[i] };
+    const bool has_value = i + 1 < argc;
+    if (arg == "--json" && has_value) {
+      options.json_path = argv[++i];
+    } else if (arg == "--baseline" && has_value) {
+      options.baseline_path = argv[++i];
+    } else if (arg == "--filter" && has_value) {
+      options.filter = argv[++i];
+    } else if (arg == "--check-timing" && has_value) {
+      options.check_timing = std::string{ argv[++i] } == "on";
+    } else if (arg == "--tolerance" && has_value) {
+      options.tolerance = std::stod(argv[++i]);
+    } else if (arg == "--update-baseline") {
+      options.update_baseline = true;
+    } else {
+      std::fprintf(stderr,
+        "usage: %s [--json out.json] [--baseline baseline.json] [--check-timing on|off] [--tolerance factor] "
+        "[--filter substring] [--update-baseline]\n",
+        argv[0]);
+      return std::nullopt;
+    }
+  }
+  if (options.update_baseline && (options.baseline_path.empty() || options.filter.empty())) {
+    std::fprintf(stderr, "--update-baseline needs --baseline and a --filter for the entries to update\n");
+    return std::nullopt;
+  }
+  return options;
+}
+
+bool within_timing(const anywho::bench::Measurement &measurement,
+  const anywho::bench::Measurement &base,
+  const Options &options)
+{
+  static constexpr double timing_slack_ns{ 2.0 };
+
+  const double reference_ns = measurement.ns_per_op / measurement.relative;
+  const double allowed_ns = reference_ns * base.relative * options.tolerance + timing_slack_ns;
+  return measurement.ns_per_op <= allowed_ns;
+}
+
+/**
+ * @brief Compare against the baseline. Allocations must never grow. Timings are compared relative to the reference
+ *        benchmark, with some absolute slack for the benchmarks that only take a few ns.
+ *
+ */
+int compare(const std::vector<anywho::bench::Measurement> &measurements,
+  const std::vector<anywho::bench::Measurement> &baseline,
+  const Options &options)
+{
+  static constexpr double allocation_slack{ 1e-3 };
+
+  int regressions = 0;
+  for (const auto &el : measurements) {
+    const auto base = std::ranges::find(baseline, el.name, &anywho::bench::Measurement::name);
+    if (base == baseline.end()) {
+      std::printf("note: %s is not in the baseline\n", el.name.c_str());
+      continue;
+    }
+
+    if (el.allocs_per_op > base->allocs_per_op + allocation_slack) {
+      std::printf("REGRESSION: %s allocates %.3f/op, baseline %.3f/op\n",
+        el.name.c_str(),
+        el.allocs_per_op,
+        base->allocs_per_op);
+      ++regressions;
+    }
+
+    if (!options.check_timing || el.relative <= 0.0 || base->relative <= 0.0) { continue; }
+
+    if (!within_timing(el, *base, options)) {
+      std::printf("REGRESSION: %s takes %.2f ns/op (x%.2f of reference), baseline x%.2f\n",
+        el.name.c_str(),
+        el.ns_per_op,
+        el.relative,
+        base->relative);
+      ++regressions;
+    }
+  }
+  return regressions;
+}
+
+/**
+ * @brief Replace the entries of the baseline that were measured, keep all others. Updating only what a deliberate
+ *        cost change affects keeps the regressions of everything else visible.
+ *
+ */
+std::vector<anywho::bench::Measurement> update(std::vector<anywho::bench::Measurement> baseline,
+  const std::vector<anywho::bench::Measurement> &measurements)
+{
+  for (const auto &el : measurements) {
+    const auto base = std::ranges::find(baseline, el.name, &anywho::bench::Measurement::name);
+    if (base == baseline.end()) {
+      std::printf("added %s\n", el.name.c_str());
+      baseline.push_back(el);
+    } else {
+      std::printf("updated %s: %.3f -> %.3f allocs/op, x%.2f -> x%.2f of reference\n",
+        el.name.c_str(),
+        base->allocs_per_op,
+        el.allocs_per_op,
+        base->relative,
+        el.relative);
+      *base = el;
+    }
+  }
+  return baseline;
+}
+
+}// namespace
+
+int main(int argc, char **argv)
+{
+  const auto options = parse_options(argc, argv);
+  if (!options) { return EXIT_FAILURE; }
+
+  const auto measurements = make_suite().run(options->filter);
+
+  std::printf("%-60s %12s %12s %10s\n", "benchmark", "ns/op", "allocs/op", "relative");
+  for (const auto &el : measurements) {
+    std::printf("%-60s %12.2f %12.3f %10.2f\n", el.name.c_str(), el.ns_per_op, el.allocs_per_op, el.relative);
+  }
+
+  if (!options->json_path.empty() && !anywho::bench::write_json(options->json_path, measurements)) {
+    std::fprintf(stderr, "could not write %s\n", options->json_path.c_str());
+    return EXIT_FAILURE;
+  }
+
+  if (options->baseline_path.empty()) { return EXIT_SUCCESS; }
+
+  const auto baseline = anywho::bench::read_json(options->baseline_path);
+  if (!baseline) {
+    std::fprintf(stderr, "could not read baseline %s\n", options->baseline_path.c_str());
+    return EXIT_FAILURE;
+  }
+
+  if (options->update_baseline) {
+    return anywho::bench::write_json(options->baseline_path, update(*baseline, measurements)) ? EXIT_SUCCESS
+                                                                                               : EXIT_FAILURE;
+  }
+
+  const int regressions = compare(measurements, *baseline, *options);
+  if (regressions > 0) {
+    std::printf("%d regression(s) against %s\n", regressions, options->baseline_path.c_str());
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace anywho::bench {
+
+/**
+ * @brief Number of calls to the global operator new. The counting operator new is defined in the benchmark
+ *        translation unit.
+ *
+ */
+inline std::atomic<std::size_t> allocation_count{ 0 };
+
+/**
+ * @brief Keep the compiler from optimizing away a value that is otherwise unused.
+ *
+ * @tparam T Type of the value
+ * @param value Value that must be materialized
+ */
+template<typename T> inline void do_not_optimize(T const &value) { asm volatile("" : : "m"(value) : "memory"); }
+
+/**
+ * @brief Opaque boolean so that the compiler can not specialize the benchmarked call chain on the path taken.
+ *
+ * @param value Value that shall be hidden from the optimizer
+ * @return bool
+ */
+inline bool opaque(bool value)
+{
+  asm volatile("" : "+r"(value));
+  return value;
+}
+
+/**
+ * @brief Result of a single benchmark.
+ *
+ */
+struct Measurement
+{
+  std::string name;
+  std::string reference;
+  double ns_per_op{ 0.0 };
+  double allocs_per_op{ 0.0 };
+  /// @brief ns_per_op divided by the ns_per_op of the reference, 0 if there is no reference
+  double relative{ 0.0 };
+};
+
+/**
+ * @brief Collection of benchmark cases. Every case may name a reference case (usually the hand-written std::expected
+ *        equivalent) against which its timing is reported relatively. Relative numbers are what the baseline check
+ *        compares, since absolute timings depend on the machine.
+ *
+ */
+class Suite
+{
+public:
+  template<typename F> void add(std::string name, std::string reference, F body)
+  {
+    // The loop lives inside the type erased function so that only one indirect call is paid per batch.
+    cases_.push_back({ std::move(name), std::move(reference), [body](std::size_t iterations) {
+                        for (std::size_t i = 0; i < iterations; ++i) { body(); }
+                      } });
+  }
+
+  [[nodiscard]] std::vector<Measurement> run(const std::string &filter) const
+  {
+    std::vector<Measurement> out;
+    for (const auto &el : cases_) {
+      if (!filter.empty() && !el.name.contains(filter) && !el.reference.contains(filter)) { continue; }
+      out.push_back(measure(el));
+    }
+
+    for (auto &measurement : out) {
+      const auto ref = std::ranges::find(out, measurement.reference, &Measurement::name);
+      if (ref != out.end() && ref->ns_per_op > 0.0) { measurement.relative = measurement.ns_per_op / ref->ns_per_op; }
+    }
+
+    return out;
+  }
+
+private:
+  struct Case
+  {
+    std::string name;
+    std::string reference;
+    std::function<void(std::size_t)> body;
+  };
+
+  static constexpr std::chrono::nanoseconds min_batch_time{ std::chrono::milliseconds{ 5 } };
+  static constexpr int repetitions{ 5 };
+
+  static Measurement measure(const Case &bench_case)
+  {
+    using clock = std::chrono::steady_clock;
+
+    // Warm up and find a batch size that runs long enough to be measured reliably.
+    std::size_t iterations = 1;
+    while (true) {
+      const auto start = clock::now();
+      bench_case.body(iterations);
+      if (clock::now() - start >= min_batch_time) { break; }
+      iterations *= 2;
+    }
+
+    double best_ns = 0.0;
+    std::size_t allocations = 0;
+    for (int rep = 0; rep < repetitions; ++rep) {
+      const std::size_t allocations_before = allocation_count.load(std::memory_order_relaxed);
+      const auto start = clock::now();
+      bench_case.body(iterations);
+      const auto stop = clock::now();
+      allocations = allocation_count.load(std::memory_order_relaxed) - allocations_before;
+
+      const double elapsed = std::chrono::duration<double, std::nano>(stop - start).count();
+      if (rep == 0 || elapsed < best_ns) { best_ns = elapsed; }
+    }
+
+    const auto ops = static_cast<double>(iterations);
+    return { bench_case.name, bench_case.reference, best_ns / ops, static_cast<double>(allocations) / ops, 0.0 };
+  }
+
+  std::vector<Case> cases_;
+};
+
+/**
+ * @brief Write measurements as JSON, one benchmark per line so that read_json can stay trivial.
+ *
+ * @param path File to write to
+ * @param measurements Results of Suite::run
+ * @return bool true on success
+ */
+inline bool write_json(const std::string &path, const std::vector<Measurement> &measurements)
+{
+  std::ofstream file{ path };
+  if (!file) { return false; }
+
+  file << "{\n  \"version\": 1,\n  \"benchmarks\": [\n";
+  for (std::size_t i = 0; i < measurements.size(); ++i) {
+    const auto &el = measurements[i];
+    file << "    {\"name\": \"" << el.name << "\", \"reference\": \"" << el.reference
+         << "\", \"ns_per_op\": " << el.ns_per_op << ", \"allocs_per_op\": " << el.allocs_per_op
+         << ", \"relative\": " << el.relative << "}" << (i + 1 < measurements.size() ? "," : "") << "\n";
+  }
+  file << "  ]\n}\n";
+
+  return static_cast<bool>(file);
+}
+
+namespace detail {
+  inline std::optional<std::string> string_field(const std::string &line, const std::string &key)
+  {
+    const std::string pattern = "\"" + key + "\": \"";
+    const auto begin = line.find(pattern);
+    if (begin == std::string::npos) { return std::nullopt; }
+    const auto value_begin = begin + pattern.size();
+    const auto value_end = line.find('"', value_begin);
+    if (value_end == std::string::npos) { return std::nullopt; }
+
+    return line.substr(value_begin, value_end - value_begin);
+  }
+
+  inline std::optional<double> number_field(const std::string &line, const std::string &key)
+  {
+    const std::string pattern = "\"" + key + "\": ";
+    const auto begin = line.find(pattern);
+    if (begin == std::string::npos) { return std::nullopt; }
+
+    return std::stod(line.substr(begin + pattern.size()));
+  }
+}// namespace detail
+
+/**
+ * @brief Read measurements previously written with write_json.
+ *
+ * @param path File to read from
+ * @return std::optional<std::vector<Measurement>> std::nullopt if the file can not be read
+ */
+inline std::optional<std::vector<Measurement>> read_json(const std::string &path)
+{
+  std::ifstream file{ path };
+  if (!file) { return std::nullopt; }
+
+  std::vector<Measurement> out;
+  std::string line;
+  while (std::getline(file, line)) {
+    auto name = detail::string_field(line, "name");
+    if (!name) { continue; }
+    out.push_back({ std::move(*name),
+      detail::string_field(line, "reference").value_or(""),
+      detail::number_field(line, "ns_per_op").value_or(0.0),
+      detail::number_field(line, "allocs_per_op").value_or(0.0),
+      detail::number_field(line, "relative").value_or(0.0) });
+  }
+
+  return out;
+}
+
+}// namespace anywho::bench
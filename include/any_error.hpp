@@ -0,0 +1,271 @@
+#pragma once
+
+#include "concepts.hpp"
+#include "context.hpp"
+#include "error_id.hpp"
+#include "format.hpp"
+#include "metrics.hpp"
+#include "propagation.hpp"
+#include "scoped_context.hpp"
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace anywho {
+
+namespace detail {
+  struct ErrorHeader;
+
+  /**
+   * @brief Output of Error::format_to behind a function pointer. Chars are collected in a buffer on the stack and
+   *        handed to the output of the caller in chunks, so that formatting neither allocates nor makes an indirect
+   *        call per char.
+   */
+  class ErasedSink final
+  {
+  public:
+    using Write = void (*)(void *target, std::string_view chunk);
+
+    ErasedSink(void *target, Write write) : target_{ target }, write_{ write } {}
+
+    void put(char c)
+    {
+      if (size_ == buffer_.size()) { flush(); }
+      buffer_[size_++] = c;
+    }
+    /// @brief Hand what was buffered to the output, must be called once formatting is done
+    void flush()
+    {
+      write_(target_, std::string_view{ buffer_.data(), size_ });
+      size_ = 0;
+    }
+
+  private:
+    std::array<char, 256> buffer_;
+    std::size_t size_{ 0 };
+    void *target_;
+    Write write_;
+  };
+
+  /// @brief Output iterator of char into an ErasedSink, which the held error formats into
+  class ErasedSinkIterator final
+  {
+  public:
+    using difference_type = std::ptrdiff_t;
+
+    explicit ErasedSinkIterator(ErasedSink &sink) : sink_{ &sink } {}
+
+    ErasedSinkIterator &operator*() { return *this; }
+    ErasedSinkIterator &operator=(char c)
+    {
+      sink_->put(c);
+      return *this;
+    }
+    ErasedSinkIterator &operator++() { return *this; }
+    ErasedSinkIterator operator++(int) { return *this; }
+
+  private:
+    ErasedSink *sink_;
+  };
+
+  /// @brief Hand written vtable of the error stored in an anywho::Error
+  struct ErrorVTable
+  {
+    TypeKey type;
+    void (*destroy)(ErrorHeader *) noexcept;
+    std::string (*format)(const ErrorHeader *);
+    void (*format_to)(const ErrorHeader *, ErasedSink &);
+    std::string (*message)(const ErrorHeader *);
+    ErrorId (*id)(const ErrorHeader *);
+    void (*consume_context)(ErrorHeader *, Context &&);
+    void (*on_propagation)(ErrorHeader *);
+    void (*capture_breadcrumbs)(ErrorHeader *);
+    void *(*upcast)(ErrorHeader *, TypeKey);
+  };
+
+  struct ErrorHeader
+  {
+    const ErrorVTable *vtable;
+  };
+
+  /// @brief Heap block behind an anywho::Error: vtable pointer followed by the error itself
+  template<typename E> struct ErrorBox final : ErrorHeader
+  {
+    template<typename... Args> explicit ErrorBox(const ErrorVTable *table, Args &&...args)
+      : ErrorHeader{ table }, payload(std::forward<Args>(args)...)
+    {}
+
+    static E &of(ErrorHeader *header) { return static_cast<ErrorBox *>(header)->payload; }
+    static const E &of(const ErrorHeader *header) { return static_cast<const ErrorBox *>(header)->payload; }
+
+    E payload;
+  };
+
+  /// @brief The error as the type of key, which must be E or one of its base_error types, nullptr otherwise
+  template<typename E> void *upcast(E &error, TypeKey key)
+  {
+    if (key == type_key_v<E>) { return &error; }
+    if constexpr (requires { typename E::base_error; }) {
+      if constexpr (!std::is_same_v<typename E::base_error, E>) {
+        return upcast<typename E::base_error>(error, key);
+      }
+    }
+    return nullptr;
+  }
+
+  template<typename E>
+  inline constexpr ErrorVTable error_vtable{
+    type_key_v<E>,
+    [](ErrorHeader *header) noexcept { delete static_cast<ErrorBox<E> *>(header); },
+    [](const ErrorHeader *header) -> std::string { return ErrorBox<E>::of(header).format(); },
+    [](const ErrorHeader *header, ErasedSink &sink) {
+      const E &error = ErrorBox<E>::of(header);
+      if constexpr (requires { error.format_to(ErasedSinkIterator{ sink }); }) {
+        error.format_to(ErasedSinkIterator{ sink });
+      } else {
+        std::ranges::copy(error.format(), ErasedSinkIterator{ sink });
+      }
+    },
+    [](const ErrorHeader *header) -> std::string { return ErrorBox<E>::of(header).message(); },
+    [](const ErrorHeader *header) -> ErrorId { return ErrorBox<E>::of(header).id(); },
+    [](ErrorHeader *header, Context &&context) { ErrorBox<E>::of(header).consume_context(std::move(context)); },
+    [](ErrorHeader *header) { detail::on_propagation(ErrorBox<E>::of(header)); },
+    [](ErrorHeader *header) { detail::on_context(ErrorBox<E>::of(header)); },
+    [](ErrorHeader *header, TypeKey key) { return upcast(ErrorBox<E>::of(header), key); },
+  };
+}// namespace detail
+
+/**
+ * @brief Type erased error that holds any concepts::Error behind a single pointer, like anyhow::Error in Rust.
+ *        The error lives in one heap block together with a pointer to its vtable, so anywho::Error is one word and
+ *        std::expected<T, anywho::Error> stays small for the happy path. Moving it copies a pointer.
+ *        Use like
+ *        std::expected<Config, anywho::Error> load(const std::string &path)
+ *        {
+ *          auto text = ANYWHO(readFile(path));// std::expected<std::string, IOError>
+ *          return ANYWHO(parse(text));// std::expected<Config, ParseError>
+ *        }
+ *        The concrete error can be recovered with is<E>() and downcast<E>(). A moved from Error must only be
+ *        assigned to or destroyed.
+ *
+ */
+class Error final
+{
+public:
+  template<typename E>
+    requires(!std::same_as<std::remove_cvref_t<E>, Error> && concepts::Error<std::remove_cvref_t<E>>)
+  Error(E &&error)
+    : Error(std::in_place_type<std::remove_cvref_t<E>>, std::forward<E>(error))
+  {}
+
+  template<concepts::Error E, typename... Args>
+  explicit Error(std::in_place_type_t<E> /*type*/, Args &&...args)
+    : box_{ new detail::ErrorBox<E>{ &detail::error_vtable<E>, std::forward<Args>(args)... } }
+  {}
+
+  Error(const Error &) = delete;
+  Error(Error &&other) noexcept : box_{ std::exchange(other.box_, nullptr) } {}
+  Error &operator=(const Error &) = delete;
+  Error &operator=(Error &&other) noexcept
+  {
+    if (this != &other) {
+      reset();
+      box_ = std::exchange(other.box_, nullptr);
+    }
+    return *this;
+  }
+  ~Error() { reset(); }
+
+  [[nodiscard]] std::string format() const { return box_->vtable->format(box_); }
+
+  /**
+   * @brief Write the formatted error to an output iterator. The held error formats through its own format_to into a
+   *        buffer on the stack, which is copied to out in chunks, so no string is built in between.
+   *
+   * @tparam OutputIt Output iterator of char
+   * @param out Where to write to
+   * @return OutputIt Iterator past the last written char
+   */
+  template<typename OutputIt> OutputIt format_to(OutputIt out) const
+  {
+    const auto write = [](void *target, std::string_view chunk) {
+      auto &it = *static_cast<OutputIt *>(target);
+      it = std::ranges::copy(chunk, it).out;
+    };
+    detail::ErasedSink sink{ &out, write };
+    box_->vtable->format_to(box_, sink);
+    sink.flush();
+
+    return out;
+  }
+
+  [[nodiscard]] std::string message() const { return box_->vtable->message(box_); }
+  [[nodiscard]] ErrorId id() const { return box_->vtable->id(box_); }
+  void consume_context(Context &&context) { box_->vtable->consume_context(box_, std::move(context)); }
+  /// @brief Forwards the propagation hook of ANYWHO and with_context to the held error
+  void on_propagation()
+  {
+    // Checked here to spare the indirect call on the common path without guards and metrics.
+    if (metrics::enabled || detail::active_breadcrumb != nullptr) { box_->vtable->on_propagation(box_); }
+  }
+  /// @brief Forwards the breadcrumbs with_context adds to the held error
+  void capture_breadcrumbs()
+  {
+    if (detail::active_breadcrumb != nullptr) { box_->vtable->capture_breadcrumbs(box_); }
+  }
+
+  /// @brief type_key_v of the held error
+  [[nodiscard]] TypeKey type_key() const { return box_->vtable->type; }
+
+  /// @brief True if the held error is of type E or derives from it, see derives_from
+  template<typename E> [[nodiscard]] bool is() const { return derives_from<E>(box_->vtable->type); }
+
+  /**
+   * @brief Access the held error as its concrete type or one of its base_error types.
+   *
+   * @tparam E Type the error was created from or a type it derives from
+   * @return E* nullptr if is<E>() is false
+   */
+  template<typename E> [[nodiscard]] E *downcast()
+  {
+    if constexpr (!std::is_abstract_v<E>) {
+      if (box_->vtable->type == type_key_v<E>) { return &detail::ErrorBox<E>::of(box_); }
+    }
+    return is<E>() ? static_cast<E *>(box_->vtable->upcast(box_, type_key_v<E>)) : nullptr;
+  }
+  template<typename E> [[nodiscard]] const E *downcast() const
+  {
+    if constexpr (!std::is_abstract_v<E>) {
+      if (box_->vtable->type == type_key_v<E>) {
+        return &detail::ErrorBox<E>::of(static_cast<const detail::ErrorHeader *>(box_));
+      }
+    }
+    return is<E>() ? static_cast<const E *>(box_->vtable->upcast(box_, type_key_v<E>)) : nullptr;
+  }
+
+private:
+  void reset()
+  {
+    if (box_ != nullptr) { box_->vtable->destroy(std::exchange(box_, nullptr)); }
+  }
+
+  detail::ErrorHeader *box_;
+};
+
+}// namespace anywho
+
+/**
+ * @brief Formatter for the type erased Error, writes the same as Error::format().
+ *
+ */
+template<> struct anywho::format_ns::formatter<anywho::Error, char>
+{
+  constexpr auto parse(auto &ctx) { return ctx.begin(); }
+
+  auto format(const anywho::Error &error, auto &ctx) const { return error.format_to(ctx.out()); }
+};
@@ -1,12 +1,26 @@
 #pragma once
 #if __cplusplus > 202002L
+#include "any_error.hpp"
+#include "async_sink.hpp"
 #include "concepts.hpp"
+#include "coroutine.hpp"
 #include "error_factories.hpp"
+#include "error_list.hpp"
+#include "match.hpp"
+#include "parallel.hpp"
+#include "wire_format.hpp"
 #endif
 #include "aliases.hpp"
 #include "context.hpp"
 #include "direct_return.hpp"
+#include "error_id.hpp"
+#include "error_registry.hpp"
 #include "errors.hpp"
 #include "fixed_string.hpp"
 #include "format.hpp"
+#include "metrics.hpp"
+#include "propagation.hpp"
+#include "scoped_context.hpp"
+#include "small_vector.hpp"
+#include "static_error.hpp"
 #include "with_context.hpp"
\ No newline at end of file
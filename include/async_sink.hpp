@@ -0,0 +1,241 @@
+#pragma once
+
+#include "concepts.hpp"
+#include "wire_format.hpp"
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#if __has_include(<unistd.h>)
+#include <unistd.h>
+#endif
+
+namespace anywho {
+
+/// @brief What submit does when the ring of an AsyncSink is full
+enum class OverflowPolicy : std::uint8_t {
+  /// @brief Drop the error and count it, the producer never waits
+  drop,
+  /// @brief Wait until the background thread made room, without locks
+  block,
+};
+
+struct SinkOptions
+{
+  OverflowPolicy overflow{ OverflowPolicy::drop };
+  /// @brief Errors registered in the error_registry are queued by id, see wire::MessageEncoding
+  wire::MessageEncoding encoding{ wire::MessageEncoding::registered };
+  /// @brief How long the background thread sleeps when there is nothing to write
+  std::chrono::microseconds idle_sleep{ 1000 };
+};
+
+/// @brief Counters of an AsyncSink, each a consistent value but not all of them taken at one point in time
+struct SinkStats
+{
+  std::uint64_t written{ 0 };
+  /// @brief Dropped because the ring was full
+  std::uint64_t dropped{ 0 };
+  /// @brief Dropped because the encoded error did not fit a record
+  std::uint64_t oversized{ 0 };
+  /// @brief Times a producer had to wait for room with OverflowPolicy::block
+  std::uint64_t blocked{ 0 };
+  /// @brief Writes that failed, f.e. because the file descriptor was closed
+  std::uint64_t failed_writes{ 0 };
+};
+
+/**
+ * @brief Formats and writes errors on a background thread, so that threads hitting errors only pay for encoding
+ *        them. Producers encode the error (see wire::encode) straight into a slot of a bounded lock-free
+ *        multi-producer ring, which never allocates and never takes a lock. The background thread formats the
+ *        records like format() of the error, one per line, and writes them in batches.
+ *        Use like
+ *        anywho::AsyncSink sink{ STDERR_FILENO };
+ *        if (!result.has_value()) { sink.submit(result.error()); }
+ *        Note that errors without a static message build their message() to compute their id.
+ *
+ * @tparam Capacity Number of records in the ring, a power of two
+ * @tparam RecordSize Bytes of one record, larger errors are dropped and counted as oversized
+ */
+template<std::size_t Capacity = 1024, std::size_t RecordSize = 512> class BasicAsyncSink final
+{
+  static_assert(std::has_single_bit(Capacity), "the capacity of the ring must be a power of two");
+
+public:
+  using Writer = std::function<bool(std::string_view)>;
+
+  /**
+   * @brief Sink writing with the given callable, which is only called from the background thread.
+   *
+   * @param writer Writes a batch of lines, returns false on failure
+   * @param options Overflow policy and encoding
+   */
+  explicit BasicAsyncSink(Writer writer, SinkOptions options = {})
+    : options_{ options }, writer_{ std::move(writer) }, slots_{ std::make_unique<Slot[]>(Capacity) }
+  {
+    for (std::size_t i = 0; i < Capacity; ++i) { slots_[i].sequence.store(i, std::memory_order_relaxed); }
+    thread_ = std::jthread{ [this](const std::stop_token &stop) { run(stop); } };
+  }
+
+#if __has_include(<unistd.h>)
+  /// @brief Sink writing to a file descriptor, which must stay open while the sink lives
+  explicit BasicAsyncSink(int fd, SinkOptions options = {})
+    : BasicAsyncSink([fd](std::string_view text) { return write_all(fd, text); }, options)
+  {}
+#endif
+
+  BasicAsyncSink(const BasicAsyncSink &) = delete;
+  BasicAsyncSink(BasicAsyncSink &&) = delete;
+  BasicAsyncSink &operator=(const BasicAsyncSink &) = delete;
+  BasicAsyncSink &operator=(BasicAsyncSink &&) = delete;
+  /// @brief Writes everything that was submitted before, submit must not be called anymore
+  ~BasicAsyncSink()
+  {
+    thread_.request_stop();
+    thread_.join();
+  }
+
+  /**
+   * @brief Queue an error to be written. Lock-free and allocation free, apart from message() of errors without a
+   *        static message.
+   *
+   * @tparam E Error type
+   * @param error Error to write
+   * @return bool false if the error was dropped
+   */
+  template<concepts::Error E> bool submit(const E &error)
+  {
+    std::size_t pos = tail_.load(std::memory_order_relaxed);
+    bool waited = false;
+    while (true) {
+      Slot &slot = slots_[pos % Capacity];
+      const std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+      if (sequence == pos) {
+        if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+      } else if (sequence < pos) {
+        // The slot still holds the record of the previous round, the ring is full.
+        if (options_.overflow == OverflowPolicy::drop) {
+          dropped_.fetch_add(1, std::memory_order_relaxed);
+          return false;
+        }
+        if (!std::exchange(waited, true)) { blocked_.fetch_add(1, std::memory_order_relaxed); }
+        std::this_thread::yield();
+        pos = tail_.load(std::memory_order_relaxed);
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+
+    Slot &slot = slots_[pos % Capacity];
+    const auto size = wire::encode(error, slot.record, options_.encoding);
+    slot.size = size.has_value() ? static_cast<std::uint32_t>(*size) : 0;
+    if (!size.has_value()) { oversized_.fetch_add(1, std::memory_order_relaxed); }
+    slot.sequence.store(pos + 1, std::memory_order_release);
+
+    return size.has_value();
+  }
+
+  /// @brief Wait until everything submitted before was written
+  void flush() const
+  {
+    const std::size_t target = tail_.load(std::memory_order_acquire);
+    while (head_.load(std::memory_order_acquire) < target) { std::this_thread::sleep_for(options_.idle_sleep / 4); }
+  }
+
+  [[nodiscard]] SinkStats stats() const
+  {
+    return { written_.load(std::memory_order_relaxed),
+      dropped_.load(std::memory_order_relaxed),
+      oversized_.load(std::memory_order_relaxed),
+      blocked_.load(std::memory_order_relaxed),
+      failed_writes_.load(std::memory_order_relaxed) };
+  }
+
+private:
+  struct Slot
+  {
+    std::atomic<std::size_t> sequence{ 0 };
+    std::uint32_t size{ 0 };
+    std::array<std::byte, RecordSize> record{};
+  };
+
+#if __has_include(<unistd.h>)
+  static bool write_all(int fd, std::string_view text)
+  {
+    while (!text.empty()) {
+      const auto written = ::write(fd, text.data(), text.size());
+      if (written < 0 && errno == EINTR) { continue; }
+      if (written <= 0) { return false; }
+      text.remove_prefix(static_cast<std::size_t>(written));
+    }
+    return true;
+  }
+#endif
+
+  void run(const std::stop_token &stop)
+  {
+    std::string batch;
+    while (!stop.stop_requested()) {
+      if (drain(batch) == 0) { std::this_thread::sleep_for(options_.idle_sleep); }
+    }
+    // Producers are done once the sink is destroyed, write what is left.
+    while (drain(batch) != 0) {}
+  }
+
+  /// @brief Format and write the records that are ready, returns their number
+  std::size_t drain(std::string &batch)
+  {
+    batch.clear();
+    std::size_t head = head_.load(std::memory_order_relaxed);
+    std::size_t count = 0;
+    std::uint64_t formatted = 0;
+    for (; count < Capacity; ++count, ++head) {
+      Slot &slot = slots_[head % Capacity];
+      if (slot.sequence.load(std::memory_order_acquire) != head + 1) { break; }
+
+      if (const auto view = wire::decode(std::span{ slot.record }.first(slot.size))) {
+        view->format_to(std::back_inserter(batch));
+        batch.push_back('\n');
+        ++formatted;
+      }
+      slot.sequence.store(head + Capacity, std::memory_order_release);
+    }
+    if (count == 0) { return 0; }
+
+    if (batch.empty() || writer_(batch)) {
+      written_.fetch_add(formatted, std::memory_order_relaxed);
+    } else {
+      failed_writes_.fetch_add(1, std::memory_order_relaxed);
+    }
+    head_.store(head, std::memory_order_release);
+    return count;
+  }
+
+  SinkOptions options_;
+  Writer writer_;
+  std::unique_ptr<Slot[]> slots_;
+  // Producers claim at the tail, the background thread releases at the head. Kept apart to not share a cache line.
+  alignas(64) std::atomic<std::size_t> tail_{ 0 };
+  alignas(64) std::atomic<std::size_t> head_{ 0 };
+  alignas(64) std::atomic<std::uint64_t> dropped_{ 0 };
+  std::atomic<std::uint64_t> oversized_{ 0 };
+  std::atomic<std::uint64_t> blocked_{ 0 };
+  std::atomic<std::uint64_t> written_{ 0 };
+  std::atomic<std::uint64_t> failed_writes_{ 0 };
+  std::jthread thread_;
+};
+
+using AsyncSink = BasicAsyncSink<>;
+
+}// namespace anywho
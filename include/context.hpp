@@ -4,14 +4,142 @@
 #include <source_location>
 #endif
 
-#include "fixed_string.hpp"
 #include "format.hpp"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <utility>
 
 namespace anywho {
 
-static constexpr size_t CONTEXT_STRING_SIZE{ 128 };
-using ContextString = FixedString<CONTEXT_STRING_SIZE>;
+/**
+ * @brief Text of a context. String literals (and other strings with static storage duration) are only referenced,
+ *        runtime strings are copied into an owned buffer. Hence the common case of a literal message costs no copy
+ *        and no allocation.
+ *        Literals bind to the consteval constructor, so handing over a runtime const char* fails to compile instead
+ *        of dangling. Wrap those into std::string_view to have them copied.
+ *
+ */
+class ContextText final
+{
+public:
+  constexpr ContextText() = default;
+
+  consteval ContextText(const char *str) : data_{ str }, size_{ static_cast<std::uint32_t>(length(str)) } {}
 
+  ContextText(std::string_view str) { copy_from(str); }
+
+  ContextText(const std::string &str) : ContextText(std::string_view{ str }) {}
+
+  /**
+   * @brief Reference text without copying it. Only for text with static storage duration that did not come in as
+   *        literal, f.e. a checked format string.
+   *
+   * @param str Text to reference
+   * @return ContextText
+   */
+  static constexpr ContextText from_static(std::string_view str)
+  {
+    ContextText out;
+    out.data_ = str.data();
+    out.size_ = static_cast<std::uint32_t>(str.size());
+    return out;
+  }
+
+  ContextText(const ContextText &other)
+  {
+    if (other.owned_) {
+      copy_from(other.view());
+    } else {
+      data_ = other.data_;
+      size_ = other.size_;
+    }
+  }
+
+  constexpr ContextText(ContextText &&other) noexcept
+    : data_{ std::exchange(other.data_, "") }, size_{ std::exchange(other.size_, 0) },
+      owned_{ std::exchange(other.owned_, false) }
+  {}
+
+  ContextText &operator=(const ContextText &other)
+  {
+    if (this != &other) { *this = ContextText{ other }; }
+    return *this;
+  }
+
+  constexpr ContextText &operator=(ContextText &&other) noexcept
+  {
+    if (this != &other) {
+      release();
+      data_ = std::exchange(other.data_, "");
+      size_ = std::exchange(other.size_, 0);
+      owned_ = std::exchange(other.owned_, false);
+    }
+    return *this;
+  }
+
+  constexpr ~ContextText() { release(); }
+
+  [[nodiscard]] constexpr std::string_view view() const { return { data_, size_ }; }
+  [[nodiscard]] constexpr bool empty() const { return size_ == 0; }
+  /// @brief True if the text references static storage instead of owning a copy
+  [[nodiscard]] constexpr bool is_static() const { return !owned_; }
+
+private:
+  static constexpr std::size_t length(const char *str) { return std::char_traits<char>::length(str); }
+
+  void copy_from(std::string_view str)
+  {
+    if (str.empty()) { return; }
+    char *buffer = new char[str.size()];
+    std::copy(str.begin(), str.end(), buffer);
+    data_ = buffer;
+    size_ = static_cast<std::uint32_t>(str.size());
+    owned_ = true;
+  }
+
+  constexpr void release()
+  {
+    if (owned_) { delete[] data_; }
+    owned_ = false;
+  }
+
+  const char *data_{ "" };
+  std::uint32_t size_{ 0 };
+  bool owned_{ false };
+};
+
+/**
+ * @brief File name of a context. Only string literals and other strings with static storage duration are allowed,
+ *        hence it is stored as a plain pointer.
+ *
+ */
+class ContextFile final
+{
+public:
+  constexpr ContextFile() = default;
+  consteval ContextFile(const char *file) : file_{ file } {}
+
+  /// @brief Reference a zero terminated file name with static storage duration that did not come in as literal
+  static constexpr ContextFile from_static(const char *file)
+  {
+    ContextFile out;
+    out.file_ = file;
+    return out;
+  }
+
+  [[nodiscard]] constexpr const char *c_str() const { return file_; }
+
+private:
+  const char *file_{ "" };
+};
 
 /**
  * @brief Intermediate struct that will allow for use with desiganted initilializers
@@ -19,9 +147,9 @@ using ContextString = FixedString<CONTEXT_STRING_SIZE>;
  */
 struct ContextParameterProxy
 {
-  ContextString message;
+  ContextText message;
   uint line;
-  ContextString file;
+  ContextFile file;
 };
 
 /**
@@ -34,6 +162,9 @@ struct ContextParameterProxy
  *        auto x = ANYWHO(myFunc(input).with_context(Context{{.message="you may not pass!", .file="myfile",
  *                                                            .line=1234}}));
  *
+ *        The file is kept as pointer (source_location::file_name() is static already) and literal messages are only
+ *        referenced, so a context is four words large and copying it does not touch the strings.
+ *
  */
 class Context final
 {
@@ -41,34 +172,261 @@ public:
   Context() = default;
 
   explicit Context(ContextParameterProxy &&init)
-    : message_{ std::move(init.message) }, line_{ init.line }, file_{ std::move(init.file) }
+    : message_{ std::move(init.message) }, file_{ init.file.c_str() }, line_{ init.line }
   {}
 
-  Context(ContextString &&msg, uint line, ContextString &&file)
-    : message_{ std::move(msg) }, line_{ line }, file_{ std::move(file) }
+  Context(ContextText &&msg, uint line, ContextFile file)
+    : message_{ std::move(msg) }, file_{ file.c_str() }, line_{ line }
   {}
 
+  /// @brief Marker that stands for count contexts a ContextPolicy dropped
+  static Context elision(std::uint32_t count)
+  {
+    Context out{ ContextText::from_static("contexts elided"), 0, ContextFile{} };
+    out.count_ = count | elision_flag;
+    return out;
+  }
+
 #if __cplusplus >= 202002L
-  Context(ContextString &&msg, std::source_location location = std::source_location::current())
-    : message_{ std::move(msg) }, line_{ location.line() }, file_{ location.file_name() }
+  Context(ContextText &&msg, std::source_location location = std::source_location::current())
+    : message_{ std::move(msg) }, file_{ location.file_name() }, line_{ location.line() }
   {}
 #else
-  Context(ContextString &&msg) : message_{ std::move(msg) }, line_{ 0 }, file_{ "" } {}
+  Context(ContextText &&msg) : message_{ std::move(msg) } {}
 #endif
 
   std::string format() const
   {
-    if (static_cast<std::string>(file_).empty() && line_ == 0) {
-      return format_ns::format("{}", static_cast<std::string>(message_));
+    std::string out;
+    format_to(std::back_inserter(out));
+
+    return out;
+  }
+
+  /**
+   * @brief Write the formatted context to an output iterator without building intermediate strings.
+   *
+   * @tparam OutputIt Output iterator of char
+   * @param out Where to write to
+   * @return OutputIt Iterator past the last written char
+   */
+  template<typename OutputIt> OutputIt format_to(OutputIt out) const
+  {
+    if (is_elision()) {
+      out = std::ranges::copy(std::string_view{ "...elided " }, out).out;
+      out = number_to(elided(), out);
+      return std::ranges::copy(std::string_view{ " contexts..." }, out).out;
+    }
+
+    if (*file_ != '\0' || line_ != 0) {
+      out = std::ranges::copy(std::string_view{ file_ }, out).out;
+      *out++ = ':';
+      out = number_to(line_, out);
+      out = std::ranges::copy(std::string_view{ " -> " }, out).out;
+    }
+    out = std::ranges::copy(message_.view(), out).out;
+    if (repeats() > 1) {
+      out = std::ranges::copy(std::string_view{ " (repeated " }, out).out;
+      out = number_to(repeats(), out);
+      out = std::ranges::copy(std::string_view{ " times)" }, out).out;
     }
 
-    return format_ns::format("{}:{} -> {}", static_cast<std::string>(file_), line_, static_cast<std::string>(message_));
+    return out;
+  }
+
+  [[nodiscard]] std::string_view message() const { return message_.view(); }
+  [[nodiscard]] std::string_view file() const { return file_; }
+  [[nodiscard]] uint line() const { return line_; }
+
+  /// @brief How often the context was added in a row, see ContextPolicy::collapsed
+  [[nodiscard]] std::uint32_t repeats() const { return is_elision() ? 1 : count_; }
+  /// @brief True for the marker of contexts a ContextPolicy dropped
+  [[nodiscard]] bool is_elision() const { return (count_ & elision_flag) != 0; }
+  /// @brief Number of contexts the marker stands for, 0 for other contexts
+  [[nodiscard]] std::uint32_t elided() const { return is_elision() ? count_ & ~elision_flag : 0; }
+  /// @brief True if both contexts have a location and it is the same
+  [[nodiscard]] bool same_location(const Context &other) const
+  {
+    return line_ != 0 && line_ == other.line_ && !is_elision() && !other.is_elision()
+           && (file_ == other.file_ || std::string_view{ file_ } == std::string_view{ other.file_ });
+  }
+  /// @brief Count more repeats of the context, or more dropped contexts for the marker. Saturates.
+  void count_more(std::uint32_t count = 1)
+  {
+    const std::uint32_t counted = count_ & ~elision_flag;
+    count_ = (count_ & elision_flag) | (count < ~elision_flag - counted ? counted + count : ~elision_flag);
   }
 
 private:
-  ContextString message_{ "" };
+  static constexpr std::uint32_t elision_flag{ 1U << 31U };
+
+  /// @brief Written by hand instead of format_to, so that formatting into fixed buffers is guaranteed not to allocate.
+  template<typename OutputIt> static OutputIt number_to(std::uint32_t value, OutputIt out)
+  {
+    std::array<char, std::numeric_limits<std::uint32_t>::digits10 + 1> digits{};
+    const auto digits_end = std::to_chars(digits.data(), digits.data() + digits.size(), value).ptr;
+
+    return std::ranges::copy(digits.data(), digits_end, out).out;
+  }
+
+  ContextText message_{};
+  const char *file_{ "" };
   uint line_{ 0 };
-  ContextString file_{ "" };
+  // Fills the padding after line_, the elision_flag marks the marker of dropped contexts
+  std::uint32_t count_{ 1 };
 };
 
-}// namespace anywho
\ No newline at end of file
+/**
+ * @brief How many contexts an error type keeps. Declare it in an error type to bound its context chain, f.e. for errors
+ *        that pass retry loops or a recursive descent:
+ *        static constexpr anywho::ContextPolicy context_policy{ anywho::ContextPolicy::keep_ends(4, 4).collapsed() };
+ *        Dropped contexts are replaced by a single marker that counts them, see Context::elision. With collapsed(),
+ *        consecutive contexts from the same file and line are counted as repeats of the first one.
+ *        GenericError reads the policy when WithStaticId or the error type pass the type to its std::type_identity
+ *        constructor. ANYWHO and with_context reject types that declare a policy their constructor does not apply.
+ *
+ */
+class ContextPolicy final
+{
+public:
+  static constexpr ContextPolicy keep_all() { return ContextPolicy{ 0, 0, false }; }
+  /// @brief The count contexts closest to where the error was created
+  static constexpr ContextPolicy keep_first(std::uint16_t count) { return ContextPolicy{ count, 0, true }; }
+  /// @brief The count most recent contexts
+  static constexpr ContextPolicy keep_last(std::uint16_t count) { return ContextPolicy{ 0, count, true }; }
+  /// @brief The first and the last contexts, with the marker in between
+  static constexpr ContextPolicy keep_ends(std::uint16_t first, std::uint16_t last)
+  {
+    return ContextPolicy{ first, last, true };
+  }
+
+  /// @brief Same policy, but consecutive contexts from the same location are kept once with a repeat count
+  [[nodiscard]] constexpr ContextPolicy collapsed() const
+  {
+    ContextPolicy out{ *this };
+    out.collapse_ = true;
+    return out;
+  }
+
+  [[nodiscard]] constexpr bool bounded() const { return bounded_; }
+  [[nodiscard]] constexpr bool collapses() const { return collapse_; }
+  [[nodiscard]] constexpr std::uint16_t first() const { return first_; }
+  [[nodiscard]] constexpr std::uint16_t last() const { return last_; }
+
+private:
+  constexpr ContextPolicy(std::uint16_t first, std::uint16_t last, bool bounded)
+    : first_{ first }, last_{ last }, bounded_{ bounded }
+  {}
+
+  std::uint16_t first_;
+  std::uint16_t last_;
+  bool bounded_;
+  bool collapse_{ false };
+};
+
+namespace detail {
+  template<typename E> constexpr ContextPolicy context_policy()
+  {
+    if constexpr (requires { E::context_policy; }) {
+      return E::context_policy;
+    } else {
+      return ContextPolicy::keep_all();
+    }
+  }
+
+  /**
+   * @brief Add a context to a chain of contexts as the policy says. Bounded chains have the layout
+   *        first contexts, marker, last contexts, the marker is added once the chain is full. The last contexts are
+   *        kept in order by moving them down, which is cheap since the policy bounds their number. The marker counts
+   *        every dropped context, including the repeats of collapsed ones.
+   *
+   * @tparam Chain Vector like container of Context
+   * @param chain Contexts so far
+   * @param policy Policy of the error type
+   * @param context Context to add
+   */
+  template<typename Chain> void add_context(Chain &chain, ContextPolicy policy, Context &&context)
+  {
+    if (policy.collapses() && chain.size() > 0 && chain[chain.size() - 1].same_location(context)) {
+      chain[chain.size() - 1].count_more();
+      return;
+    }
+    const std::size_t first = policy.first();
+    const std::size_t kept = first + policy.last();
+    if (!policy.bounded() || chain.size() < kept) {
+      chain.emplace_back(std::move(context));
+    } else if (chain.size() == kept) {
+      if (policy.last() == 0) {
+        chain.emplace_back(Context::elision(context.repeats()));
+      } else {
+        const std::uint32_t dropped = chain[first].repeats();
+        chain.emplace_back(std::move(context));
+        chain[first] = Context::elision(dropped);
+      }
+    } else if (policy.last() == 0) {
+      chain[first].count_more(context.repeats());
+    } else {
+      chain[first].count_more(chain[first + 1].repeats());
+      std::move(chain.begin() + static_cast<std::ptrdiff_t>(first + 2), chain.end(),
+        chain.begin() + static_cast<std::ptrdiff_t>(first + 1));
+      chain[chain.size() - 1] = std::move(context);
+    }
+  }
+}// namespace detail
+
+#if __cplusplus >= 202002L
+namespace detail {
+  /**
+   * @brief Format string that is checked against the arguments at compile time and picks up the location of the
+   *        caller through the default argument. Used by everything that formats contexts lazily.
+   *
+   * @tparam Args Types of the format arguments
+   */
+  template<typename... Args> struct FormatWithLocation
+  {
+    template<typename S>
+      requires std::convertible_to<const S &, std::string_view>
+    consteval FormatWithLocation(const S &str, std::source_location loc = std::source_location::current())
+      : text{ str }, location{ loc }
+    {
+      static_cast<void>(format_ns::format_string<Args...>{ str });
+    }
+
+    std::string_view text;
+    std::source_location location;
+  };
+
+  /**
+   * @brief Format a context from a format string that was checked by FormatWithLocation. Without arguments the
+   *        string is a literal that can be referenced, unless escaped braces have to be resolved.
+   *
+   * @tparam Args Types of the format arguments
+   * @param fmt Checked format string
+   * @param location Location the context refers to
+   * @param args Format arguments
+   * @return Context
+   */
+  template<typename... Args>
+  Context make_formatted_context(std::string_view fmt, const std::source_location &location, const Args &...args)
+  {
+    if constexpr (sizeof...(Args) == 0) {
+      if (!fmt.contains('{') && !fmt.contains('}')) { return { ContextText::from_static(fmt), location }; }
+    }
+
+    return { ContextText{ format_ns::vformat(fmt, format_ns::make_format_args(args...)) }, location };
+  }
+}// namespace detail
+#endif
+
+}// namespace anywho
+
+/**
+ * @brief Formatter for Context, writes the same as Context::format() without building a string.
+ *
+ */
+template<> struct anywho::format_ns::formatter<anywho::Context, char>
+{
+  constexpr auto parse(auto &ctx) { return ctx.begin(); }
+
+  auto format(const anywho::Context &context, auto &ctx) const { return context.format_to(ctx.out()); }
+};
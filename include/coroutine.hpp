@@ -0,0 +1,273 @@
+#pragma once
+
+#include "concepts.hpp"
+#include "has_error.hpp"
+#include "propagation.hpp"
+#include <coroutine>
+#include <cstddef>
+#include <expected>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+// The coroutine returns ExpectedReturn, which is converted to std::expected only after the body ran. Compilers that
+// convert the result of get_return_object right away would read the result before it was set.
+#if defined(__clang__)
+#if __clang_major__ < 16
+#error "anywho/coroutine.hpp needs the delayed conversion of get_return_object of clang >= 16"
+#endif
+#elif !defined(__GNUC__)
+#error "anywho/coroutine.hpp needs the delayed conversion of get_return_object of gcc or clang >= 16"
+#endif
+
+namespace anywho {
+
+/**
+ * @brief Source of coroutine frames for functions that propagate with co_await, see ScopedFrameAllocator.
+ *
+ */
+class FrameAllocator
+{
+public:
+  FrameAllocator() = default;
+  FrameAllocator(const FrameAllocator &) = delete;
+  FrameAllocator(FrameAllocator &&) = delete;
+  FrameAllocator &operator=(const FrameAllocator &) = delete;
+  FrameAllocator &operator=(FrameAllocator &&) = delete;
+  virtual ~FrameAllocator() = default;
+
+  /// @brief Memory for a frame, aligned to __STDCPP_DEFAULT_NEW_ALIGNMENT__
+  [[nodiscard]] virtual void *allocate(std::size_t size) = 0;
+  virtual void deallocate(void *ptr, std::size_t size) noexcept = 0;
+};
+
+/**
+ * @brief Default frame allocator, one per thread. Coroutines propagating with co_await never suspend, so their frames
+ *        are freed in reverse order of allocation and a stack of bytes is enough: allocating moves the top up,
+ *        freeing moves it back. The stack is allocated on first use, frames that do not fit anymore come from the
+ *        heap.
+ *
+ */
+class FrameArena final : public FrameAllocator
+{
+public:
+  static constexpr std::size_t default_capacity{ std::size_t{ 64 } * 1024 };
+
+  explicit FrameArena(std::size_t capacity = default_capacity) : capacity_{ capacity } {}
+
+  [[nodiscard]] void *allocate(std::size_t size) override
+  {
+    size = align(size);
+    if (buffer_ == nullptr) { buffer_ = std::make_unique<std::byte[]>(capacity_); }
+    if (size > capacity_ - top_) { return ::operator new(size); }
+
+    void *ptr = buffer_.get() + top_;
+    top_ += size;
+    return ptr;
+  }
+
+  void deallocate(void *ptr, std::size_t size) noexcept override
+  {
+    auto *bytes = static_cast<std::byte *>(ptr);
+    if (buffer_ != nullptr && bytes >= buffer_.get() && bytes < buffer_.get() + capacity_) {
+      top_ = static_cast<std::size_t>(bytes - buffer_.get());
+    } else {
+      ::operator delete(ptr, align(size));
+    }
+  }
+
+  /// @brief Bytes of the stack in use
+  [[nodiscard]] std::size_t used() const { return top_; }
+
+private:
+  static constexpr std::size_t align(std::size_t size)
+  {
+    constexpr std::size_t alignment{ __STDCPP_DEFAULT_NEW_ALIGNMENT__ };
+    return (size + alignment - 1) / alignment * alignment;
+  }
+
+  std::size_t capacity_;
+  std::unique_ptr<std::byte[]> buffer_{};
+  std::size_t top_{ 0 };
+};
+
+namespace detail {
+  inline constinit thread_local FrameAllocator *frame_allocator{ nullptr };
+
+  inline FrameAllocator &current_frame_allocator()
+  {
+    if (frame_allocator == nullptr) [[unlikely]] {
+      thread_local FrameArena arena;
+      frame_allocator = &arena;
+    }
+    return *frame_allocator;
+  }
+}// namespace detail
+
+/**
+ * @brief Serve the frames of coroutines that are called on this thread while the guard is alive from allocator.
+ *        Use like
+ *        anywho::FrameArena arena{ 1024 * 1024 };
+ *        anywho::ScopedFrameAllocator guard{ arena };
+ *
+ */
+class ScopedFrameAllocator final
+{
+public:
+  explicit ScopedFrameAllocator(FrameAllocator &allocator)
+    : previous_{ std::exchange(detail::frame_allocator, &allocator) }
+  {}
+  ScopedFrameAllocator(const ScopedFrameAllocator &) = delete;
+  ScopedFrameAllocator(ScopedFrameAllocator &&) = delete;
+  ScopedFrameAllocator &operator=(const ScopedFrameAllocator &) = delete;
+  ScopedFrameAllocator &operator=(ScopedFrameAllocator &&) = delete;
+  ~ScopedFrameAllocator() { detail::frame_allocator = previous_; }
+
+private:
+  FrameAllocator *previous_;
+};
+
+namespace detail {
+  template<typename T, typename E> class ExpectedPromise;
+
+  /**
+   * @brief What the coroutine returns before it ran. Converted to std::expected when the coroutine is done, which
+   *        needs the delayed conversion of the result of get_return_object that gcc and clang >= 16 implement. Other
+   *        compilers are rejected at the top of this file.
+   *
+   */
+  template<typename T, typename E> class ExpectedReturn final
+  {
+  public:
+    explicit ExpectedReturn(ExpectedPromise<T, E> &promise) { promise.result_ = &result_; }
+    ExpectedReturn(const ExpectedReturn &) = delete;
+    ExpectedReturn(ExpectedReturn &&) = delete;
+    ExpectedReturn &operator=(const ExpectedReturn &) = delete;
+    ExpectedReturn &operator=(ExpectedReturn &&) = delete;
+    ~ExpectedReturn() = default;
+
+    // value() throws instead of reading an empty result, should the conversion ever happen before the body ran.
+    operator std::expected<T, E>() { return std::move(result_).value(); }
+
+  private:
+    std::optional<std::expected<T, E>> result_{};
+  };
+
+  /**
+   * @brief Suspends only if the awaited std::expected holds an error. The error is handed to the result of the
+   *        coroutine and the coroutine is destroyed instead of resumed, like an early return.
+   *
+   */
+  template<typename Expected> class PropagateAwaiter final
+  {
+  public:
+    explicit PropagateAwaiter(Expected &&expected) : expected_{ std::move(expected) } {}
+    explicit PropagateAwaiter(const Expected &expected) : expected_{ expected } {}
+
+    [[nodiscard]] bool await_ready() const noexcept { return expected_.has_value(); }
+
+    template<typename Promise> void await_suspend(std::coroutine_handle<Promise> handle)
+    {
+      handle.promise().fail(std::move(expected_).error());
+      // Destroys this awaiter too, nothing must be touched afterwards.
+      handle.destroy();
+    }
+
+    decltype(auto) await_resume()
+    {
+      if constexpr (!std::is_void_v<typename Expected::value_type>) { return std::move(*expected_); }
+    }
+
+  private:
+    Expected expected_;
+  };
+
+  template<typename T, typename E> class ExpectedPromiseBase
+  {
+  public:
+    template<typename U = T> void return_value(U &&value) { result_->emplace(std::forward<U>(value)); }
+
+  protected:
+    std::optional<std::expected<T, E>> *result_{ nullptr };
+  };
+
+  template<typename E> class ExpectedPromiseBase<void, E>
+  {
+  public:
+    void return_void() { result_->emplace(); }
+
+  protected:
+    std::optional<std::expected<void, E>> *result_{ nullptr };
+  };
+
+  /**
+   * @brief Promise of coroutines returning std::expected<T, E>. Coroutines run to completion without suspending,
+   *        co_await only stops them early on errors.
+   *
+   */
+  template<typename T, typename E> class ExpectedPromise final : public ExpectedPromiseBase<T, E>
+  {
+  public:
+    ExpectedReturn<T, E> get_return_object() { return ExpectedReturn<T, E>{ *this }; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    [[noreturn]] void unhandled_exception() { throw; }
+
+    /// @brief co_await works on std::expected only, with errors that convert to E
+    template<typename X>
+      requires IsExpected<std::remove_cvref_t<X>>::value
+               && std::constructible_from<E, typename std::remove_cvref_t<X>::error_type &&>
+    PropagateAwaiter<std::remove_cvref_t<X>> await_transform(X &&expected)
+    {
+      return PropagateAwaiter<std::remove_cvref_t<X>>{ std::forward<X>(expected) };
+    }
+
+    template<typename G> void fail(G &&error)
+    {
+      E converted(std::forward<G>(error));
+      this->result_->emplace(std::unexpect, std::move(on_propagation(converted)));
+    }
+
+    // The allocator is stored in front of the frame, so that it is freed where it came from.
+    static void *operator new(std::size_t size)
+    {
+      FrameAllocator &allocator = current_frame_allocator();
+      auto *block = static_cast<std::byte *>(allocator.allocate(size + header_size));
+      ::new (block) FrameAllocator *(&allocator);
+      return block + header_size;
+    }
+
+    static void operator delete(void *ptr, std::size_t size) noexcept
+    {
+      auto *block = static_cast<std::byte *>(ptr) - header_size;
+      (*std::launder(reinterpret_cast<FrameAllocator **>(block)))->deallocate(block, size + header_size);
+    }
+
+  private:
+    friend class ExpectedReturn<T, E>;
+
+    static constexpr std::size_t header_size{ __STDCPP_DEFAULT_NEW_ALIGNMENT__ };
+  };
+}// namespace detail
+
+}// namespace anywho
+
+/**
+ * @brief Functions returning std::expected<T, E> with an anywho error E can be coroutines that propagate errors with
+ *        co_await, as a portable alternative to ANYWHO:
+ *        std::expected<Config, anywho::GenericError> load(const std::string &path)
+ *        {
+ *          auto text = co_await readFile(path);// returns early with the error of readFile
+ *          co_return parse(text);
+ *        }
+ *        Frames come from the FrameAllocator of the thread, by default a FrameArena, so the happy path does not
+ *        allocate.
+ *
+ */
+template<typename T, anywho::concepts::Error E, typename... Args>
+struct std::coroutine_traits<std::expected<T, E>, Args...>
+{
+  using promise_type = anywho::detail::ExpectedPromise<T, E>;
+};
@@ -4,29 +4,37 @@
 #pragma clang diagnostic ignored "-Wgnu-statement-expression"
 #endif
 #include "has_error.hpp"
+#include "propagation.hpp"
+#include <utility>
 
 #if __cplusplus > 202002L
 /**
  * @brief Macro allowing to return directly the unexpected value or continue with the truth value (without std::expected
  * wrapped around it) the extension "gnu statement expression" is currently the only way to solve this but supported by
  * gcc, clang and msvc
+ * Error and value are moved out of the result, so move-only types are supported and errors are not copied.
+ * Breadcrumbs of active ScopedContext guards that the error does not have yet are added on the way out.
  *
  */
-#define ANYWHO(expr)                                                               \
-  __extension__({                                                                  \
-    auto __result = expr;                                                          \
-    if (anywho::has_error(__result)) { return std::unexpected(__result.error()); } \
-    __result.value();                                                              \
+#define ANYWHO(expr)                                                                       \
+  __extension__({                                                                          \
+    auto __result = expr;                                                                  \
+    if (anywho::has_error(__result)) {                                                     \
+      return std::unexpected(anywho::detail::on_propagation(std::move(__result).error())); \
+    }                                                                                      \
+    std::move(__result).value();                                                           \
   })
 
 // Alias that is shorter
 #define TRY ANYWHO
 
-#define ANYWHO_OPT(expr)                                                              \
-  __extension__({                                                                     \
-    auto __result = expr;                                                             \
-    if (anywho::has_error(__result)) { return std::make_optional(__result.error()); } \
-    __result.value();                                                                 \
+#define ANYWHO_OPT(expr)                                                                      \
+  __extension__({                                                                             \
+    auto __result = expr;                                                                     \
+    if (anywho::has_error(__result)) {                                                        \
+      return std::make_optional(anywho::detail::on_propagation(std::move(__result).error())); \
+    }                                                                                         \
+    std::move(__result).value();                                                              \
   })
 
 #define TRY_O ANYWHO_OPT
@@ -36,10 +44,12 @@
  * @brief Same as ANYWHO but for std::optional<Error>. For projects that are bound to version before cpp23.
  *
  */
-#define ANYWHO_LEGACY(expr)                                                           \
-  __extension__({                                                                     \
-    auto __result = expr;                                                             \
-    if (anywho::has_error(__result)) { return std::make_optional(__result.value()); } \
+#define ANYWHO_LEGACY(expr)                                                                   \
+  __extension__({                                                                             \
+    auto __result = expr;                                                                     \
+    if (anywho::has_error(__result)) {                                                        \
+      return std::make_optional(anywho::detail::on_propagation(std::move(__result).value())); \
+    }                                                                                         \
   })
 
 #define TRY_LEG ANYWHO_LEGACY
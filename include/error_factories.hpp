@@ -1,48 +1,121 @@
 #pragma once
 
 #include "concepts.hpp"
+#include "error_id.hpp"
+#include "error_registry.hpp"
 #include "errors.hpp"
+#include "format.hpp"
 #include "with_context.hpp"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <concepts>
+#include <cstddef>
 #include <expected>
 #include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 
 namespace anywho {
 
+namespace detail {
+  template<typename T> struct IsErrorState : std::false_type
+  {
+  };
+  template<concepts::Error E> struct IsErrorState<std::optional<E>> : std::true_type
+  {
+  };
+
+  /// @brief Tuple like result of the callables of make_error: a status of type Status, then the value
+  template<typename R, template<typename> typename Status>
+  concept StatusAndValue = requires {
+    requires std::tuple_size<std::remove_cvref_t<R>>::value == 2;
+    requires Status<std::remove_cvref_t<std::tuple_element_t<0, std::remove_cvref_t<R>>>>::value;
+  };
+
+  template<typename T> using IsBool = std::is_same<T, bool>;
+  template<typename T> using IsErrorCode = std::is_same<T, std::error_code>;
+
+  template<typename E> struct ErrorOf
+  {
+    using type = std::remove_cvref_t<E>;
+  };
+  template<typename F>
+    requires(!concepts::Error<std::remove_cvref_t<F>>) && std::invocable<F>
+  struct ErrorOf<F>
+  {
+    using type = std::remove_cvref_t<std::invoke_result_t<F>>;
+  };
+
+  /// @brief Error type of an error or of a callable creating one
+  template<typename E> using error_of_t = typename ErrorOf<E>::type;
+
+  /// @brief An error, or a callable that creates the error only when it is needed
+  template<typename E>
+  concept ErrorOrFactory = concepts::Error<error_of_t<E>>;
+
+  template<typename E> std::unexpected<error_of_t<E>> unexpected_from(E &&error)
+  {
+    if constexpr (concepts::Error<std::remove_cvref_t<E>>) {
+      return std::unexpected<error_of_t<E>>(std::forward<E>(error));
+    } else {
+      return std::unexpected<error_of_t<E>>(std::invoke(std::forward<E>(error)));
+    }
+  }
+
+  /// @brief Error of an int status that is -1 with errno set or an errno value
+  inline std::error_code code_from_status(int status)
+  {
+    return std::error_code{ status == -1 ? errno : status, std::generic_category() };
+  }
+}// namespace detail
+
 /**
- * @brief Factory function for functions using boolean success flags
+ * @brief Factory function for functions using boolean success flags. Instead of the error a callable creating it can
+ *        be given, which is only called on failure, like
+ *        anywho::make_error(success, output, [] { return anywho::GenericError{}; });
  *
  * @tparam T Type of the expected value
- * @tparam E Error type
+ * @tparam E Error type or callable returning the error
  * @param has_no_error Value of the boolean flag
- * @param truth_value Expected value
- * @param error Instance of the error that shall be returned
+ * @param truth_value Expected value, forwarded into the result
+ * @param error Instance of the error that shall be returned or callable creating it
  * @return std::expected<T, E>
  */
-template<typename T, concepts::Error E>
-inline std::expected<T, E> make_error(bool has_no_error, T truth_value, E &&error)
+template<typename T, detail::ErrorOrFactory E>
+inline std::expected<std::remove_cvref_t<T>, detail::error_of_t<E>>
+  make_error(bool has_no_error, T &&truth_value, E &&error)
 {
   if (has_no_error) {
-    return std::expected<T, E>{ truth_value };
+    return std::expected<std::remove_cvref_t<T>, detail::error_of_t<E>>{ std::in_place, std::forward<T>(truth_value) };
   } else {
-    return std::unexpected(error);
+    return detail::unexpected_from(std::forward<E>(error));
   }
 }
 
 /**
  * @brief Factory function for functions using boolean success flags
+ *        Use like
+ *        auto exp = anywho::make_error([] { int out = 0; return std::tuple{ legacy(out), out }; }, MyError{});
  *
- * @tparam T Type of the expected value
- * @tparam E Error type
+ * @tparam F Callable returning a tuple of the boolean flag and the value
+ * @tparam E Error type or callable returning the error
  * @param callable Callable in which the function that shall be evaluated is wrapped
- * @param error Instance of the error that shall be returned
+ * @param error Instance of the error that shall be returned or callable creating it
  * @return std::expected<T, E>
  */
-template<typename T, concepts::Error E>
-inline std::expected<T, E> make_error(std::function<std::tuple<bool, T>(void)> callable, E &&error)
+template<std::invocable F, detail::ErrorOrFactory E>
+  requires detail::StatusAndValue<std::invoke_result_t<F>, detail::IsBool>
+inline auto make_error(F &&callable, E &&error)
 {
-  const auto [has_no_error, truth_value] = callable();
+  auto [has_no_error, value] = std::invoke(std::forward<F>(callable));
 
-  return make_error(has_no_error, truth_value, std::move(error));
+  return make_error(has_no_error, std::move(value), std::forward<E>(error));
 }
 
 /**
@@ -51,32 +124,33 @@ inline std::expected<T, E> make_error(std::function<std::tuple<bool, T>(void)> c
  * @tparam T Type of the expected value
  * @tparam E Error type
  * @param error optional error, having error or not
- * @param truth_value Expected value
+ * @param truth_value Expected value, forwarded into the result
  * @return std::expected<T, E>
  */
-template<typename T, concepts::Error E> inline std::expected<T, E> make_error(std::optional<E> &&error, T truth_value)
+template<typename T, concepts::Error E>
+inline std::expected<std::remove_cvref_t<T>, E> make_error(std::optional<E> &&error, T &&truth_value)
 {
   if (!has_error(error)) {
-    return std::expected<T, E>{ truth_value };
+    return std::expected<std::remove_cvref_t<T>, E>{ std::in_place, std::forward<T>(truth_value) };
   } else {
-    return std::unexpected(error.value());
+    return std::unexpected(std::move(*error));
   }
 }
 
 /**
  * @brief Factory function for functions std::optional<Error>
  *
- * @tparam T Type of the expected value
- * @tparam E Error type
+ * @tparam F Callable returning a tuple of the optional error and the value
  * @param callable Callable in which the function that shall be evaluated is wrapped
  * @return std::expected<T, E>
  */
-template<typename T, concepts::Error E>
-inline std::expected<T, E> make_error(std::function<std::tuple<std::optional<E>, T>(void)> callable)
+template<std::invocable F>
+  requires detail::StatusAndValue<std::invoke_result_t<F>, detail::IsErrorState>
+inline auto make_error(F &&callable)
 {
-  auto [error, truth_value] = callable();
+  auto [error, value] = std::invoke(std::forward<F>(callable));
 
-  return make_error(std::move(error), truth_value);
+  return make_error(std::move(error), std::move(value));
 }
 
 /**
@@ -84,13 +158,15 @@ inline std::expected<T, E> make_error(std::function<std::tuple<std::optional<E>,
  *
  * @tparam T Type of the expected value
  * @param error_code Error code that was returned by the function to be evaluated
- * @param truth_value Expected value
+ * @param truth_value Expected value, forwarded into the result
  * @return std::expected<T, E>
  */
-template<typename T> inline std::expected<T, ErrorFromCode> make_error(std::error_code error_code, T truth_value)
+template<typename T>
+inline std::expected<std::remove_cvref_t<T>, ErrorFromCode> make_error(const std::error_code &error_code,
+  T &&truth_value)
 {
   if (!error_code) {
-    return std::expected<T, ErrorFromCode>{ truth_value };
+    return std::expected<std::remove_cvref_t<T>, ErrorFromCode>{ std::in_place, std::forward<T>(truth_value) };
   } else {
     return std::unexpected(ErrorFromCode(error_code));
   }
@@ -99,17 +175,161 @@ template<typename T> inline std::expected<T, ErrorFromCode> make_error(std::erro
 /**
  * @brief Factory function for functions using std::error_code
  *
- * @tparam T Type of the expected value
+ * @tparam F Callable returning a tuple of the error code and the value
  * @param callable Callable in which the function that shall be evaluated is wrapped
- * @param truth_value Expected value
  * @return std::expected<T, E>
  */
+template<std::invocable F>
+  requires detail::StatusAndValue<std::invoke_result_t<F>, detail::IsErrorCode>
+inline auto make_error(F &&callable)
+{
+  auto [error_code, value] = std::invoke(std::forward<F>(callable));
+
+  return make_error(error_code, std::move(value));
+}
+
+/**
+ * @brief Factory function for POSIX functions that return -1 and set errno on failure, like read or open. errno is
+ *        read right away, so call it directly on the result.
+ *        Use like
+ *        std::expected<ssize_t, anywho::ErrorFromCode> count = anywho::make_error_from_errno(::read(fd, buf, size));
+ *
+ * @tparam R Integral return type of the function
+ * @param result Value returned by the function
+ * @return std::expected<R, ErrorFromCode>
+ */
+template<std::signed_integral R> inline std::expected<R, ErrorFromCode> make_error_from_errno(R result)
+{
+  if (result != -1) {
+    return std::expected<R, ErrorFromCode>{ std::in_place, result };
+  } else {
+    return std::unexpected(ErrorFromCode(std::error_code{ errno, std::generic_category() }));
+  }
+}
+
+/**
+ * @brief Factory function for functions returning an int status that is 0 on success and either -1 with errno set
+ *        or an errno value otherwise, like pthread_mutex_lock.
+ *
+ * @tparam T Type of the expected value
+ * @param status Status returned by the function
+ * @param truth_value Expected value, forwarded into the result
+ * @return std::expected<T, ErrorFromCode>
+ */
 template<typename T>
-inline std::expected<T, ErrorFromCode> make_error(std::function<std::tuple<std::error_code, T>(void)> callable)
+inline std::expected<std::remove_cvref_t<T>, ErrorFromCode> make_error_from_status(int status, T &&truth_value)
+{
+  if (status == 0) {
+    return std::expected<std::remove_cvref_t<T>, ErrorFromCode>{ std::in_place, std::forward<T>(truth_value) };
+  } else {
+    return std::unexpected(ErrorFromCode(detail::code_from_status(status)));
+  }
+}
+
+/**
+ * @brief Factory function for C functions that return a status and write their result through an out parameter.
+ *        The callable gets a reference to a value initialized T to hand on. The status is either a std::error_code
+ *        or an int as for make_error_from_status.
+ *        Use like
+ *        auto size = anywho::make_error_from_out<std::size_t>(
+ *          [&attr](std::size_t &out) { return pthread_attr_getstacksize(&attr, &out); });
+ *
+ * @tparam T Type of the out parameter
+ * @tparam F Callable taking T&
+ * @param callable Callable in which the function that shall be evaluated is wrapped
+ * @return std::expected<T, ErrorFromCode>
+ */
+template<typename T, std::invocable<T &> F>
+  requires std::same_as<std::invoke_result_t<F, T &>, int>
+           || std::same_as<std::remove_cvref_t<std::invoke_result_t<F, T &>>, std::error_code>
+inline std::expected<T, ErrorFromCode> make_error_from_out(F &&callable)
+{
+  T out{};
+  const auto status = std::invoke(std::forward<F>(callable), out);
+  if constexpr (std::same_as<std::remove_cvref_t<decltype(status)>, std::error_code>) {
+    return make_error(status, std::move(out));
+  } else {
+    return make_error_from_status(status, std::move(out));
+  }
+}
+
+/**
+ * @brief Factory function for C functions that return a boolean success flag and write their result through an out
+ *        parameter.
+ *
+ * @tparam T Type of the out parameter
+ * @tparam F Callable taking T& and returning bool
+ * @tparam E Error type or callable returning the error
+ * @param callable Callable in which the function that shall be evaluated is wrapped
+ * @param error Instance of the error that shall be returned or callable creating it
+ * @return std::expected<T, E>
+ */
+template<typename T, std::invocable<T &> F, detail::ErrorOrFactory E>
+  requires std::same_as<std::invoke_result_t<F, T &>, bool>
+inline std::expected<T, detail::error_of_t<E>> make_error_from_out(F &&callable, E &&error)
 {
-  const auto [error_code, truth_value] = callable();
+  T out{};
+  const bool has_no_error = std::invoke(std::forward<F>(callable), out);
 
-  return make_error(error_code, truth_value);
+  return make_error(has_no_error, std::move(out), std::forward<E>(error));
 }
 
-}// namespace anywho
\ No newline at end of file
+
+/**
+ * @brief std::error_category of the error type E, for handing anywho errors over C-ABI boundaries as std::error_code.
+ *        The name is the name of the error type (see error_registry). Values are folded error ids, message() gives
+ *        the static_message of E or, for errors with messages known only at runtime, the name and the value.
+ *
+ * @tparam E Error type
+ */
+template<typename E> class ErrorCategory final : public std::error_category
+{
+public:
+  constexpr ErrorCategory() = default;
+
+  /// @brief Value of the codes of errors with the id, never 0 since that means success
+  static constexpr int value_of(ErrorId id)
+  {
+    const auto folded = static_cast<int>((id ^ (id >> (sizeof(ErrorId) * 4U))) & 0x7fffffffU);
+    return folded != 0 ? folded : 1;
+  }
+
+  [[nodiscard]] const char *name() const noexcept override { return name_.data(); }
+  [[nodiscard]] std::string message(int value) const override
+  {
+    if constexpr (requires { E::static_message; }) {
+      return std::string{ E::static_message };
+    } else {
+      return format_ns::format("{} {}", detail::error_name<E>(), value);
+    }
+  }
+
+private:
+  static constexpr auto name_ = [] {
+    constexpr std::string_view name = detail::error_name<E>();
+    std::array<char, name.size() + 1> out{};
+    std::ranges::copy(name, out.begin());
+    return out;
+  }();
+};
+
+/// @brief The one instance of ErrorCategory<E>, its address identifies the category
+template<typename E> inline constinit const ErrorCategory<E> error_category_v{};
+
+/**
+ * @brief Reverse bridge: the error as std::error_code, f.e. to return it from an extern "C" function. The category is
+ *        generated for E, the value derived from the id, so equal errors give equal codes.
+ *
+ * @tparam E Error type
+ * @param error Error to convert
+ * @return std::error_code
+ */
+template<concepts::Error E> inline std::error_code to_error_code(const E &error)
+{
+  return std::error_code{ ErrorCategory<E>::value_of(error.id()), error_category_v<E> };
+}
+
+/// @brief Errors that came from a std::error_code give back the original code
+inline std::error_code to_error_code(const ErrorFromCode &error) { return error.get_code(); }
+
+}// namespace anywho
@@ -1,57 +1,138 @@
 #pragma once
 
+#include "concepts.hpp"
+#include "error_id.hpp"
+#include "error_registry.hpp"
 #include "errors.hpp"
+#include "fixed_string.hpp"
 #include "format.hpp"
+#include "with_context.hpp"
+#include <algorithm>
+#include <cstddef>
 #include <exception>
-#include <memory>
+#include <expected>
+#include <functional>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 
 namespace anywho {
 
 /**
  * @brief Build an error from an exception. This serves as a brdige from exception based error handling to anywho.
+ *        The caught exception is kept alive through a std::exception_ptr, so it can be rethrown with its dynamic
+ *        type, and its what() text is copied into a fixed buffer, so creating the error does not allocate. The
+ *        message is only formatted when it is asked for. The id depends on the type the exception was caught as.
  * Due to a bug in libc++ and clang, we need to set ASAN_OPTIONS=alloc_dealloc_mismatch=0.
  * Since this might be inadequte for some projects we seperate this class from the rest.
  *
  */
-class ErrorFromException final : public GenericError
+class [[gnu::visibility("default")]] ErrorFromException final : public GenericError
 {
 public:
-  ErrorFromException(const std::shared_ptr<std::exception> &exc) : exc_{ exc } {}
-  [[nodiscard]] constexpr std::string message() const override
+  using base_error = GenericError;
+
+  /// @brief Longest what() text that is kept, longer ones are cut off
+  static constexpr std::size_t what_capacity{ 127 };
+
+  /// @brief Id of errors from exceptions caught as Exc, a hash of its name. Like messages of different errors, names of
+  ///        exception types in anonymous namespaces of different files may be the same.
+  template<typename Exc> static constexpr ErrorId id_of() { return hash_id(detail::type_name<Exc>()); }
+
+  /**
+   * @brief Call inside the catch block, like
+   *        catch (const std::runtime_error &exc) { return ErrorFromException(exc, std::current_exception()); }
+   *
+   * @tparam Exc Type the exception was caught as
+   * @param exc The caught exception, only read for its what() text
+   * @param exception Pointer to the caught exception
+   */
+  template<concepts::Catchable Exc>
+  ErrorFromException(const Exc &exc, std::exception_ptr exception)
+    : GenericError(std::type_identity<ErrorFromException>{}), exception_{ std::move(exception) }, id_{ id_of<Exc>() }
   {
-    return format_ns::format("error happened with exception '{}'", exc_->what());
+    const char *what = exc.what();
+    // Only looks at the first what_capacity + 1 chars, long texts are not even measured
+    what_ = std::string_view{ what, static_cast<std::size_t>(std::find(what, what + what_capacity + 1, '\0') - what) };
   }
 
-  [[nodiscard]] const std::shared_ptr<std::exception> &get_exception_ptr() const { return exc_; }
+  [[nodiscard]] std::string message() const override
+  {
+    return format_ns::format("error happened with exception '{}'", what_.view());
+  }
+  [[nodiscard]] ErrorId id() const override { return id_; }
+  [[nodiscard]] TypeKey type_key() const override { return type_key_v<ErrorFromException>; }
+
+  /// @brief what() of the exception, cut off after what_capacity chars
+  [[nodiscard]] std::string_view what() const { return what_.view(); }
+  [[nodiscard]] const std::exception_ptr &get_exception_ptr() const { return exception_; }
 
 private:
-  ///@brief Pointer to exception interface. Needs to be shared_ptr, since std::expected needs copyiability.
-  std::shared_ptr<std::exception> exc_;
+  std::exception_ptr exception_;
+  ErrorId id_;
+  FixedString<what_capacity + 1> what_{};
 };
 
 #if __cplusplus > 202002L
+namespace detail {
+  template<typename R, typename F> R invoke_into(F &callable)
+  {
+    if constexpr (std::is_void_v<typename R::value_type>) {
+      std::invoke(callable);
+      return R{};
+    } else {
+      return R{ std::in_place, std::invoke(callable) };
+    }
+  }
+
+  /**
+   * @brief Wraps callable, which returns R, into one try block per exception type, the first type innermost. So the
+   *        first type that matches handles the exception, as with consecutive catch clauses. After inlining the
+   *        compiler emits a single landing pad for all of them.
+   *
+   */
+  template<typename R, typename F, typename Exc, typename... Rest> R catch_in_order(F &callable)
+  {
+    auto guarded = [&callable]() -> R {
+      try {
+        return callable();
+      } catch (const Exc &exc) {
+        return std::unexpected(ErrorFromException(exc, std::current_exception()));
+      }
+    };
+    if constexpr (sizeof...(Rest) == 0) {
+      return guarded();
+    } else {
+      return catch_in_order<R, decltype(guarded), Rest...>(guarded);
+    }
+  }
+}// namespace detail
+
 /**
- * @brief Factory for ErrorFromException. This can be used as a bridge from exception bsed error handling.
+ * @brief Factory for ErrorFromException. This can be used as a bridge from exception based error handling.
+ *        Every exception type gets its own error id, see ErrorFromException::id_of. Types are tried in the given
+ *        order, like catch clauses.
  * Example:
  *  const std::expected<int, anywho::ErrorFromException> exp =
- *    anywho::make_error_from_throwable<int, std::runtime_error>([]() { return myFunc(); });
+ *    anywho::make_error_from_throwable<int, std::invalid_argument, std::runtime_error>([]() { return myFunc(); });
  * This would be great to have with the other error_factories, but due to a bug in clang we need to seperate it
  * (see ErrorFromException)
  *
  * @tparam T Return type of the wrapping callable
- * @tparam Exc Exception that you want to catch
- * @param invocable Wrap the function that throws into this callable.
+ * @tparam Excs Exceptions that you want to catch
+ * @tparam F Callable returning T
+ * @param callable Wrap the function that throws into this callable.
  * @return std::expected<T, ErrorFromException>
  */
-template<typename T, concepts::Catchable Exc>
-inline std::expected<T, ErrorFromException> make_error_from_throwable(std::function<T(void)> invocable)
+template<typename T, concepts::Catchable... Excs, std::invocable F>
+  requires(sizeof...(Excs) > 0) && std::convertible_to<std::invoke_result_t<F>, T>
+inline std::expected<T, ErrorFromException> make_error_from_throwable(F &&callable)
 {
-  try {
-    return invocable();
-  } catch (const Exc &exc) {
-    return std::unexpected(ErrorFromException(std::make_shared<std::exception>(exc)));
-  }
+  using Result = std::expected<T, ErrorFromException>;
+  auto invoke = [&callable] { return detail::invoke_into<Result>(callable); };
+
+  return detail::catch_in_order<Result, decltype(invoke), Excs...>(invoke);
 }
 
 /**
@@ -67,21 +148,23 @@ inline std::expected<T, ErrorFromException> make_error_from_throwable(std::funct
  * @tparam T Return type of the wrapping callable
  * @tparam E Error that you want to generate
  * @tparam Exc Exception that you want to catch
- * @param invocable Wrap the function that throws into this callable.
+ * @tparam F Callable returning T
+ * @param callable Wrap the function that throws into this callable.
  * @param error Instance of the error that shall be returned.
  * @return std::expected<T, E>
  */
-template<typename T, concepts::Error E, concepts::Catchable Exc>
-inline std::expected<T, E> make_any_error_from_throwable(std::function<T(void)> invocable, E &&error)
+template<typename T, concepts::Error E, concepts::Catchable Exc, std::invocable F>
+  requires std::convertible_to<std::invoke_result_t<F>, T>
+inline std::expected<T, E> make_any_error_from_throwable(F &&callable, E &&error)
 {
   try {
-    return invocable();
+    return detail::invoke_into<std::expected<T, E>>(callable);
   } catch (const Exc &exc) {
     std::expected<T, E> exp = std::unexpected(std::move(error));
-    return with_context(std::move(exp), { exc.what() });
+    return with_context(std::move(exp), { std::string_view{ exc.what() } });
   }
 }
 #endif
 
 
-}// namespace anywho
\ No newline at end of file
+}// namespace anywho
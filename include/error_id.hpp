@@ -0,0 +1,151 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+namespace anywho {
+
+/// @brief Type of the unique identifier every error returns through id()
+using ErrorId = std::size_t;
+
+namespace detail {
+  template<std::size_t Bytes> struct FnvParameters;
+  template<> struct FnvParameters<4>
+  {
+    static constexpr std::uint32_t offset{ 2166136261U };
+    static constexpr std::uint32_t prime{ 16777619U };
+  };
+  template<> struct FnvParameters<8>
+  {
+    static constexpr std::uint64_t offset{ 14695981039346656037ULL };
+    static constexpr std::uint64_t prime{ 1099511628211ULL };
+  };
+
+  /// @brief Name of T as spelled by the compiler, without the need for RTTI
+  template<typename T> constexpr std::string_view type_name()
+  {
+#if defined(__clang__) || defined(__GNUC__)
+    constexpr std::string_view function{ __PRETTY_FUNCTION__ };
+    constexpr std::string_view prefix{ "T = " };
+    constexpr auto begin = function.find(prefix) + prefix.size();
+    constexpr auto end = function.find_first_of(";]", begin);
+    return function.substr(begin, end - begin);
+#else
+#error "anywho names types through __PRETTY_FUNCTION__ and needs GCC or Clang"
+#endif
+  }
+
+  /// @brief Key of a type, linked to the key of the error type it derives from
+  struct TypeNode
+  {
+    const TypeNode *base;
+  };
+
+  template<typename T> constexpr const TypeNode *base_node();
+
+  /// @brief Address of type_key<T> identifies T without RTTI. Exported, so that shared libraries built with hidden
+  ///        visibility share one key per type, as they share the type_info of exported types.
+  template<typename T> [[gnu::visibility("default")]] inline constexpr TypeNode type_key{ base_node<T>() };
+
+  /// @brief Key of T::base_error, which WithStaticId and the errors of anywho declare, nullptr for root types
+  template<typename T> constexpr const TypeNode *base_node()
+  {
+    if constexpr (requires { typename T::base_error; }) {
+      if constexpr (!std::is_same_v<typename T::base_error, T>) { return &type_key<typename T::base_error>; }
+    }
+    return nullptr;
+  }
+}// namespace detail
+
+/// @brief Identifies a type without RTTI, see type_key_v
+using TypeKey = const detail::TypeNode *;
+
+/**
+ * @brief FNV-1a hash of a string. Used to compute error ids at compile time from the message literal of an error.
+ *        Contrary to std::hash this is constexpr and gives the same ids on every platform.
+ *
+ * @param str String to hash
+ * @param seed Hash to continue from, to hash several parts as if they were concatenated
+ * @return ErrorId
+ */
+constexpr ErrorId hash_id(std::string_view str, ErrorId seed = detail::FnvParameters<sizeof(ErrorId)>::offset)
+{
+  using Fnv = detail::FnvParameters<sizeof(ErrorId)>;
+  ErrorId hash = seed;
+  for (const char el : str) {
+    hash ^= static_cast<unsigned char>(el);
+    hash *= Fnv::prime;
+  }
+  return hash;
+}
+
+/**
+ * @brief Id of an error type that declares its message at compile time through
+ *        static constexpr std::string_view static_message.
+ *
+ * @tparam E Error type
+ */
+template<typename E>
+  requires requires { E::static_message; }
+inline constexpr ErrorId static_id_v = hash_id(E::static_message);
+
+/**
+ * @brief Key of the type E itself, as opposed to the id of the errors it creates. Lets match, is and as tell error
+ *        types apart without RTTI, see type_key() of the error base classes. It is the address of an object of its
+ *        own per type, hence unique even for types of the same name in anonymous namespaces of different files.
+ *        Across shared libraries the key is the same if E has default visibility, like for type_info: export error
+ *        types that are matched outside of the library that creates them.
+ *        The key links to the key of E::base_error, so that derives_from can follow a hierarchy of error types.
+ *
+ * @tparam E Error type
+ */
+template<typename E> inline constexpr TypeKey type_key_v = &detail::type_key<E>;
+
+/**
+ * @brief True if the type of key is the type of base or derives from it, following the base_error of each type.
+ *
+ * @param key Key of the dynamic type, f.e. type_key() of an error
+ * @param base Key of the type to look for
+ */
+constexpr bool derives_from(TypeKey key, TypeKey base)
+{
+  for (; key != nullptr; key = key->base) {
+    if (key == base) { return true; }
+  }
+  return false;
+}
+
+/// @brief derives_from for a base known at compile time, final types need only the one compare
+template<typename E> constexpr bool derives_from(TypeKey key)
+{
+  if constexpr (std::is_final_v<E>) {
+    return key == type_key_v<E>;
+  } else {
+    return derives_from(key, type_key_v<E>);
+  }
+}
+
+/**
+ * @brief Check at compile time that no two of the given error types share an id. All types must declare a
+ *        static_message, f.e. by deriving from WithStaticId.
+ *        Use like
+ *        static_assert(anywho::unique_ids<IOError, ParseError, TimeoutError>(), "error ids collide");
+ *
+ * @tparam Es Error types to check
+ * @return true if all ids are distinct
+ */
+template<typename... Es> consteval bool unique_ids()
+{
+  const std::array<ErrorId, sizeof...(Es)> ids{ static_id_v<Es>... };
+  for (std::size_t i = 0; i < ids.size(); ++i) {
+    for (std::size_t j = i + 1; j < ids.size(); ++j) {
+      if (ids[i] == ids[j]) { return false; }
+    }
+  }
+  return true;
+}
+
+}// namespace anywho
@@ -0,0 +1,538 @@
+#pragma once
+
+#include "concepts.hpp"
+#include "context.hpp"
+#include "error_id.hpp"
+#include "format.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace anywho {
+
+/**
+ * @brief Collects many errors, f.e. all failures of a batch validation instead of only the first one.
+ *        Errors are copied into large blocks of memory: the message and contexts of an error are interned once per
+ *        block and every error only stores its id and references to them, so a thousand errors with the same
+ *        contexts cost little more than one. Lists built on different threads are combined with merge, which only
+ *        links their blocks.
+ *        Use like
+ *        anywho::ErrorList errors;
+ *        for (const auto &row : rows) {
+ *          if (auto result = validate(row); !result.has_value()) { errors.push(result.error()); }
+ *        }
+ *        if (!errors.empty()) { return std::unexpected(std::move(errors)); }
+ *        The list itself is an error, contexts added to it describe the list as a whole.
+ *        A list must not be used by several threads at once.
+ *
+ */
+class ErrorList final
+{
+  struct Interned;
+  struct Header;
+  struct Block;
+
+public:
+  static constexpr std::size_t default_block_size{ std::size_t{ 16 } * 1024 };
+  static constexpr ErrorId list_id{ hash_id("anywho::ErrorList") };
+
+  /// @brief Context of an error in the list, stored once per block
+  class ContextRef final
+  {
+  public:
+    [[nodiscard]] std::string_view file() const { return record_->file; }
+    [[nodiscard]] uint line() const { return record_->line; }
+    [[nodiscard]] std::string_view message() const { return { record_->text, record_->size }; }
+
+    /// @brief Written like Context::format_to
+    template<typename OutputIt> OutputIt format_to(OutputIt out) const
+    {
+      return Context{ ContextText::from_static(message()), record_->line, ContextFile::from_static(record_->file) }
+        .format_to(out);
+    }
+
+  private:
+    friend class ErrorList;
+    explicit ContextRef(const void *record) : record_{ std::launder(static_cast<const Interned *>(record)) } {}
+
+    const Interned *record_;
+  };
+
+  /// @brief One error of the list
+  class Entry final
+  {
+  public:
+    [[nodiscard]] ErrorId id() const { return header().id; }
+    [[nodiscard]] std::string_view message() const { return { header().message, header().message_size }; }
+    [[nodiscard]] std::size_t context_count() const { return header().context_count; }
+    [[nodiscard]] ContextRef context(std::size_t index) const
+    {
+      return ContextRef{ block_->bytes.get() + block_->context_offset(offset_, index) };
+    }
+
+    [[nodiscard]] std::string format() const
+    {
+      std::string out;
+      format_to(std::back_inserter(out));
+
+      return out;
+    }
+
+    /// @brief Written like the error was: message, then the contexts
+    template<typename OutputIt> OutputIt format_to(OutputIt out) const
+    {
+      out = std::ranges::copy(message(), out).out;
+      for (std::size_t i = 0; i < context_count(); ++i) {
+        out = std::ranges::copy(std::string_view{ "::" }, out).out;
+        out = context(i).format_to(out);
+      }
+      return out;
+    }
+
+  private:
+    friend class ErrorList;
+    Entry(const Block *block, std::size_t offset) : block_{ block }, offset_{ offset } {}
+
+    [[nodiscard]] const Header &header() const { return block_->header(offset_); }
+
+    const Block *block_;
+    std::size_t offset_;
+  };
+
+  class Iterator final
+  {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Entry;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = Entry;
+
+    Iterator() = default;
+
+    [[nodiscard]] Entry operator*() const { return Entry{ block_, offset_ }; }
+    Iterator &operator++()
+    {
+      offset_ += block_->entry_size(offset_);
+      if (offset_ == block_->front) {
+        block_ = block_->next.get();
+        offset_ = 0;
+      }
+      return *this;
+    }
+    Iterator operator++(int)
+    {
+      Iterator old = *this;
+      ++*this;
+      return old;
+    }
+    bool operator==(const Iterator &) const = default;
+
+  private:
+    friend class ErrorList;
+    Iterator(const Block *block, std::size_t offset) : block_{ block }, offset_{ offset } {}
+
+    const Block *block_{ nullptr };
+    std::size_t offset_{ 0 };
+  };
+
+  ErrorList() = default;
+  /// @brief Errors larger than block_size get a block of their own
+  explicit ErrorList(std::size_t block_size) : block_size_{ block_size } {}
+  ErrorList(const ErrorList &) = delete;
+  ErrorList(ErrorList &&other) noexcept
+    : head_{ std::move(other.head_) }, tail_{ std::exchange(other.tail_, nullptr) },
+      size_{ std::exchange(other.size_, 0) }, block_size_{ other.block_size_ }, contexts_{ std::move(other.contexts_) }
+  {}
+  ErrorList &operator=(const ErrorList &) = delete;
+  ErrorList &operator=(ErrorList &&other) noexcept
+  {
+    if (this != &other) {
+      release();
+      head_ = std::move(other.head_);
+      tail_ = std::exchange(other.tail_, nullptr);
+      size_ = std::exchange(other.size_, 0);
+      block_size_ = other.block_size_;
+      contexts_ = std::move(other.contexts_);
+    }
+    return *this;
+  }
+  ~ErrorList() { release(); }
+
+  /**
+   * @brief Add a copy of an error. Errors with a static_message reference it instead of copying it. The contexts of
+   *        FixedSizeError and of errors that only expose format() are kept as one context.
+   *
+   * @tparam E Error type
+   * @param error Error to add
+   */
+  template<concepts::Error E> void push(const E &error)
+  {
+    if constexpr (requires { error.contexts(); }) {
+      add(error, error.contexts());
+    } else if constexpr (requires { error.context_view(); }) {
+      add(error, flat_context(error.context_view()));
+    } else {
+      const std::string formatted = error.format();
+      std::string_view flat{ formatted };
+      const std::string message = error.message();
+      if (flat.starts_with(message)) { flat.remove_prefix(message.size()); }
+      add(error, flat_context(flat));
+    }
+  }
+
+  /**
+   * @brief Move all errors of other to the end of this list without copying them, other is empty afterwards.
+   *        Contexts that were added to other as a whole are added to this list.
+   *
+   * @param other List to take the errors from
+   */
+  void merge(ErrorList &&other)
+  {
+    if (this == &other) { return; }
+    if (other.head_ != nullptr) {
+      if (tail_ == nullptr) {
+        head_ = std::move(other.head_);
+      } else {
+        tail_->next = std::move(other.head_);
+      }
+      tail_ = std::exchange(other.tail_, nullptr);
+      size_ += std::exchange(other.size_, 0);
+    }
+    std::ranges::move(other.contexts_, std::back_inserter(contexts_));
+    other.contexts_.clear();
+  }
+
+  [[nodiscard]] std::size_t size() const { return size_; }
+  [[nodiscard]] bool empty() const { return size_ == 0; }
+  [[nodiscard]] Iterator begin() const { return Iterator{ head_.get(), 0 }; }
+  [[nodiscard]] Iterator end() const { return Iterator{}; }
+
+  /// @brief Bytes of the blocks that are in use
+  [[nodiscard]] std::size_t memory_used() const
+  {
+    std::size_t used = 0;
+    for (const Block *block = head_.get(); block != nullptr; block = block->next.get()) {
+      used += block->front + (block->capacity - block->back);
+    }
+    return used;
+  }
+
+  [[nodiscard]] std::string format() const
+  {
+    std::string out;
+    format_to(std::back_inserter(out));
+
+    return out;
+  }
+
+  /**
+   * @brief Write the message and contexts of the list, then every error on a line of its own.
+   *
+   * @tparam OutputIt Output iterator of char
+   * @param out Where to write to
+   * @return OutputIt Iterator past the last written char
+   */
+  template<typename OutputIt> OutputIt format_to(OutputIt out) const
+  {
+    out = format_head(out);
+    for (const Entry entry : *this) {
+      out = std::ranges::copy(std::string_view{ "\n  " }, out).out;
+      out = entry.format_to(out);
+    }
+    return out;
+  }
+
+  [[nodiscard]] std::string summary() const
+  {
+    std::string out;
+    summary_to(std::back_inserter(out));
+
+    return out;
+  }
+
+  /**
+   * @brief Write the message and contexts of the list, then one line per id with the number of errors and the
+   *        message of the first of them, the most frequent first. Contexts of the errors are left out.
+   *
+   * @tparam OutputIt Output iterator of char
+   * @param out Where to write to
+   * @return OutputIt Iterator past the last written char
+   */
+  template<typename OutputIt> OutputIt summary_to(OutputIt out) const
+  {
+    struct Group
+    {
+      std::size_t first;
+      std::size_t count;
+      std::string_view message;
+    };
+    std::vector<Group> groups;
+    std::unordered_map<ErrorId, std::size_t> index;
+    for (const Entry entry : *this) {
+      const auto [found, inserted] = index.try_emplace(entry.id(), groups.size());
+      if (inserted) { groups.push_back({ groups.size(), 0, entry.message() }); }
+      ++groups[found->second].count;
+    }
+    std::ranges::sort(groups, [](const Group &lhs, const Group &rhs) {
+      return lhs.count != rhs.count ? lhs.count > rhs.count : lhs.first < rhs.first;
+    });
+
+    out = format_head(out);
+    for (const auto &group : groups) { out = format_ns::format_to(out, "\n  {}x {}", group.count, group.message); }
+    return out;
+  }
+
+  [[nodiscard]] std::string message() const
+  {
+    return format_ns::format("{} error{} happened", size_, size_ == 1 ? "" : "s");
+  }
+  [[nodiscard]] ErrorId id() const { return list_id; }
+  void consume_context(Context &&context) { contexts_.emplace_back(std::move(context)); }
+  /// @brief Contexts of the list as a whole
+  [[nodiscard]] const std::vector<Context> &contexts() const { return contexts_; }
+
+private:
+  /// @brief Interned context or message, placed at the end of a block
+  struct Interned
+  {
+    const char *file;
+    const char *text;
+    uint line;
+    std::uint32_t size;
+  };
+
+  /// @brief Error, placed at the front of a block and followed by the offsets of its contexts
+  struct Header
+  {
+    ErrorId id;
+    const char *message;
+    std::uint32_t message_size;
+    std::uint32_t context_count;
+  };
+
+  static constexpr std::size_t alignment{ std::max(alignof(Interned), alignof(Header)) };
+
+  static constexpr std::size_t align_up(std::size_t size) { return (size + alignment - 1) / alignment * alignment; }
+
+  /**
+   * @brief Errors grow from the front, interned contexts and their text from the back. Interned records are found
+   *        through an open addressing table of their offsets + 1.
+   *
+   */
+  struct Block
+  {
+    explicit Block(std::size_t size) : capacity{ size }, bytes{ std::make_unique_for_overwrite<std::byte[]>(size) } {}
+
+    [[nodiscard]] std::size_t room() const { return back - front; }
+
+    [[nodiscard]] const Header &header(std::size_t offset) const
+    {
+      return *std::launder(reinterpret_cast<const Header *>(bytes.get() + offset));
+    }
+
+    [[nodiscard]] std::size_t entry_size(std::size_t offset) const
+    {
+      return align_up(sizeof(Header) + header(offset).context_count * sizeof(std::uint32_t));
+    }
+
+    [[nodiscard]] std::uint32_t context_offset(std::size_t offset, std::size_t index) const
+    {
+      return *std::launder(
+        reinterpret_cast<const std::uint32_t *>(bytes.get() + offset + sizeof(Header) + index * sizeof(std::uint32_t)));
+    }
+
+    /// @brief Offset of the record for file, line and text, added if the block does not have it yet
+    std::uint32_t intern(const char *file, uint line, std::string_view text)
+    {
+      if ((interned + 1) * 2 > table.size()) { grow_table(); }
+
+      const std::size_t mask = table.size() - 1;
+      for (std::size_t slot = hash(file, line, text) & mask;; slot = (slot + 1) & mask) {
+        if (table[slot] == 0) {
+          table[slot] = place(file, line, text) + 1;
+          ++interned;
+          return table[slot] - 1;
+        }
+        const Interned &record = at(table[slot] - 1);
+        if (record.file == file && record.line == line && std::string_view{ record.text, record.size } == text) {
+          return table[slot] - 1;
+        }
+      }
+    }
+
+    /// @brief Interned message of errors with the given id, nullptr if the block has none
+    [[nodiscard]] const Interned *message_of(ErrorId id) const
+    {
+      const auto found = messages.find(id);
+      return found != messages.end() ? &at(found->second) : nullptr;
+    }
+
+    std::uint32_t intern_message(ErrorId id, std::string_view text)
+    {
+      const std::uint32_t offset = intern("", 0, text);
+      messages.emplace(id, offset);
+      return offset;
+    }
+
+    [[nodiscard]] const Interned &at(std::uint32_t offset) const
+    {
+      return *std::launder(reinterpret_cast<const Interned *>(bytes.get() + offset));
+    }
+
+    static std::size_t hash(const char *file, uint line, std::string_view text)
+    {
+      constexpr std::size_t golden{ static_cast<std::size_t>(0x9e3779b97f4a7c15ULL) };
+      return hash_id(text) ^ ((std::bit_cast<std::uintptr_t>(file) + line) * golden);
+    }
+
+    std::uint32_t place(const char *file, uint line, std::string_view text)
+    {
+      back -= text.size();
+      std::ranges::copy(text, reinterpret_cast<char *>(bytes.get() + back));
+      const char *copy = reinterpret_cast<const char *>(bytes.get() + back);
+
+      back = (back - sizeof(Interned)) / alignment * alignment;
+      ::new (bytes.get() + back) Interned{ file, copy, line, static_cast<std::uint32_t>(text.size()) };
+      return static_cast<std::uint32_t>(back);
+    }
+
+    void grow_table()
+    {
+      std::vector<std::uint32_t> old = std::exchange(table, std::vector<std::uint32_t>(std::max<std::size_t>(
+                                                              std::size_t{ 64 }, table.size() * 2)));
+      const std::size_t mask = table.size() - 1;
+      for (const std::uint32_t entry : old) {
+        if (entry == 0) { continue; }
+        const Interned &record = at(entry - 1);
+        std::size_t slot = hash(record.file, record.line, { record.text, record.size }) & mask;
+        while (table[slot] != 0) { slot = (slot + 1) & mask; }
+        table[slot] = entry;
+      }
+    }
+
+    std::unique_ptr<Block> next{};
+    std::size_t capacity;
+    std::unique_ptr<std::byte[]> bytes;
+    std::size_t front{ 0 };
+    std::size_t back{ capacity };
+    std::size_t interned{ 0 };
+    std::vector<std::uint32_t> table{};
+    std::unordered_map<ErrorId, std::uint32_t> messages{};
+  };
+
+  /// @brief The contexts of errors that only have them as formatted text, as a single context
+  static std::vector<Context> flat_context(std::string_view text)
+  {
+    if (text.starts_with("::")) { text.remove_prefix(2); }
+    std::vector<Context> out;
+    if (!text.empty()) { out.emplace_back(ContextText::from_static(text), 0, ContextFile{}); }
+    return out;
+  }
+
+  template<typename E, typename Contexts> void add(const E &error, const Contexts &contexts)
+  {
+    constexpr bool static_message = requires { E::static_message; };
+    const ErrorId id = error.id();
+
+    // Upper bound, as if nothing was interned yet
+    const std::size_t front_size = align_up(sizeof(Header) + contexts.size() * sizeof(std::uint32_t));
+    std::size_t back_size = 0;
+    for (const auto &context : contexts) { back_size += context.message().size() + sizeof(Interned) + alignment; }
+
+    // The message of an id is only built if the block does not know it yet.
+    const Interned *known = nullptr;
+    std::string message;
+    if constexpr (!static_message) {
+      if (tail_ != nullptr && tail_->room() >= front_size + back_size) { known = tail_->message_of(id); }
+      if (known == nullptr) {
+        message = error.message();
+        back_size += message.size() + sizeof(Interned) + alignment;
+      }
+    }
+    Block &block = reserve(front_size + back_size);
+
+    const char *text = nullptr;
+    std::uint32_t text_size = 0;
+    if constexpr (static_message) {
+      text = E::static_message.data();
+      text_size = static_cast<std::uint32_t>(E::static_message.size());
+    } else {
+      const Interned &record = known != nullptr ? *known : block.at(block.intern_message(id, message));
+      text = record.text;
+      text_size = record.size;
+    }
+
+    std::byte *entry = block.bytes.get() + block.front;
+    ::new (entry) Header{ id, text, text_size, static_cast<std::uint32_t>(contexts.size()) };
+    std::byte *offsets = entry + sizeof(Header);
+    for (const auto &context : contexts) {
+      ::new (offsets) std::uint32_t{ block.intern(context.file().data(), context.line(), context.message()) };
+      offsets += sizeof(std::uint32_t);
+    }
+    block.front += front_size;
+    ++size_;
+  }
+
+
+  Block &reserve(std::size_t size)
+  {
+    if (tail_ == nullptr || tail_->room() < size) {
+      auto block = std::make_unique<Block>(align_up(std::max(block_size_, size)));
+      Block *added = block.get();
+      if (tail_ == nullptr) {
+        head_ = std::move(block);
+      } else {
+        tail_->next = std::move(block);
+      }
+      tail_ = added;
+    }
+    return *tail_;
+  }
+
+  template<typename OutputIt> OutputIt format_head(OutputIt out) const
+  {
+    out = format_ns::format_to(out, "{} error{} happened", size_, size_ == 1 ? "" : "s");
+    for (const auto &el : contexts_) {
+      out = std::ranges::copy(std::string_view{ "::" }, out).out;
+      out = el.format_to(out);
+    }
+    return out;
+  }
+
+  /// @brief Unlink the blocks one by one, so that long chains do not recurse
+  void release()
+  {
+    while (head_ != nullptr) { head_ = std::move(head_->next); }
+    tail_ = nullptr;
+    size_ = 0;
+  }
+
+  std::unique_ptr<Block> head_{};
+  Block *tail_{ nullptr };
+  std::size_t size_{ 0 };
+  std::size_t block_size_{ default_block_size };
+  std::vector<Context> contexts_{};
+};
+
+}// namespace anywho
+
+/**
+ * @brief Formatter for ErrorList, every error on a line of its own.
+ *
+ */
+template<> struct anywho::format_ns::formatter<anywho::ErrorList, char>
+{
+  constexpr auto parse(auto &ctx) { return ctx.begin(); }
+
+  auto format(const anywho::ErrorList &errors, auto &ctx) const { return errors.format_to(ctx.out()); }
+};
@@ -0,0 +1,241 @@
+#pragma once
+
+#include "error_id.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace anywho {
+
+/// @brief How bad an error is, for logging and metrics
+enum class Severity : std::uint8_t { debug, info, warning, error, fatal };
+
+/**
+ * @brief Name of a severity, f.e. for log lines.
+ *
+ * @param severity Severity to name
+ * @return std::string_view
+ */
+constexpr std::string_view severity_name(Severity severity)
+{
+  switch (severity) {
+  case Severity::debug:
+    return "debug";
+  case Severity::info:
+    return "info";
+  case Severity::warning:
+    return "warning";
+  case Severity::error:
+    return "error";
+  case Severity::fatal:
+    return "fatal";
+  }
+  return "unknown";
+}
+
+/**
+ * @brief Static description of an error type: id, name, message literal and severity. Descriptors must have static
+ *        storage duration, the registry only links them and never copies them. Define them constinit, f.e.
+ *        constinit anywho::ErrorDescriptor io_error{ "IOError", "IO error happened", anywho::Severity::warning };
+ */
+class ErrorDescriptor final
+{
+public:
+  constexpr ErrorDescriptor(ErrorId id, std::string_view name, std::string_view message, Severity severity)
+    : id_{ id }, name_{ name }, message_{ message }, severity_{ severity }
+  {}
+
+  /// @brief Descriptor whose id is the hash of the message, like errors deriving from WithStaticId
+  constexpr ErrorDescriptor(std::string_view name, std::string_view message, Severity severity = Severity::error)
+    : ErrorDescriptor(hash_id(message), name, message, severity)
+  {}
+
+  ErrorDescriptor(const ErrorDescriptor &) = delete;
+  ErrorDescriptor(ErrorDescriptor &&) = delete;
+  ErrorDescriptor &operator=(const ErrorDescriptor &) = delete;
+  ErrorDescriptor &operator=(ErrorDescriptor &&) = delete;
+  ~ErrorDescriptor() = default;
+
+  [[nodiscard]] constexpr ErrorId id() const { return id_; }
+  [[nodiscard]] constexpr std::string_view name() const { return name_; }
+  [[nodiscard]] constexpr std::string_view message() const { return message_; }
+  [[nodiscard]] constexpr Severity severity() const { return severity_; }
+
+private:
+  friend class ErrorRegistry;
+
+  ErrorId id_;
+  std::string_view name_;
+  std::string_view message_;
+  Severity severity_;
+  // Written once before the descriptor is published, only read afterwards.
+  std::atomic<const ErrorDescriptor *> next_{ nullptr };
+  std::atomic<bool> linked_{ false };
+};
+
+/**
+ * @brief Append-only registry mapping error ids to their descriptors, so that logging and metrics can resolve ids
+ *        without constructing errors. Descriptors are linked into a fixed number of buckets: adding is lock-free
+ *        (one compare-and-swap per attempt), finding is wait-free (walks one bucket that only ever grows at the head).
+ *        The registry is constant initialized, so descriptors can be added during static initialization of any
+ *        translation unit.
+ *
+ */
+class ErrorRegistry final
+{
+public:
+  static constexpr std::size_t bucket_count{ 256 };
+
+  constexpr ErrorRegistry() = default;
+  ErrorRegistry(const ErrorRegistry &) = delete;
+  ErrorRegistry(ErrorRegistry &&) = delete;
+  ErrorRegistry &operator=(const ErrorRegistry &) = delete;
+  ErrorRegistry &operator=(ErrorRegistry &&) = delete;
+  ~ErrorRegistry() = default;
+
+  /**
+   * @brief Add a descriptor. Safe to call concurrently from any number of threads.
+   *
+   * @param descriptor Descriptor with static storage duration
+   * @return bool false if this descriptor or another one with the same id was added before, the latter is recorded
+   *         as a collision, see for_each_collision
+   */
+  bool add(ErrorDescriptor &descriptor)
+  {
+    // Linking a descriptor twice would make its bucket cyclic.
+    if (descriptor.linked_.exchange(true, std::memory_order_acq_rel)) { return false; }
+
+    auto &head = buckets_[bucket(descriptor.id())];
+    const ErrorDescriptor *expected = head.load(std::memory_order_acquire);
+    do {
+      if (find_from(expected, descriptor.id()) != nullptr) {
+        add_collision(descriptor);
+        return false;
+      }
+      descriptor.next_.store(expected, std::memory_order_relaxed);
+    } while (!head.compare_exchange_weak(expected, &descriptor, std::memory_order_release, std::memory_order_acquire));
+
+    return true;
+  }
+
+  /**
+   * @brief Find the descriptor of an id.
+   *
+   * @param id Id as returned by the id() of an error
+   * @return const ErrorDescriptor* nullptr if nothing was added for id
+   */
+  [[nodiscard]] const ErrorDescriptor *find(ErrorId id) const
+  {
+    return find_from(buckets_[bucket(id)].load(std::memory_order_acquire), id);
+  }
+
+  /**
+   * @brief Call f for every descriptor added so far.
+   *
+   * @tparam F Callable taking const ErrorDescriptor &
+   * @param f Callable
+   */
+  template<typename F> void for_each(F &&f) const
+  {
+    for (const auto &head : buckets_) {
+      for (const auto *el = head.load(std::memory_order_acquire); el != nullptr;
+           el = el->next_.load(std::memory_order_relaxed)) {
+        f(*el);
+      }
+    }
+  }
+
+  /**
+   * @brief Call f for every descriptor that was not added because another one with the same id was added before.
+   *        find returns the other one for its id, so this is empty unless two error types clash.
+   *
+   * @tparam F Callable taking const ErrorDescriptor &
+   * @param f Callable
+   */
+  template<typename F> void for_each_collision(F &&f) const
+  {
+    for (const auto *el = collisions_.load(std::memory_order_acquire); el != nullptr;
+         el = el->next_.load(std::memory_order_relaxed)) {
+      f(*el);
+    }
+  }
+
+private:
+  static constexpr std::size_t bucket(ErrorId id) { return id % bucket_count; }
+
+  static const ErrorDescriptor *find_from(const ErrorDescriptor *el, ErrorId id)
+  {
+    // next_ is published together with the descriptor by the release in add, relaxed loads are enough.
+    for (; el != nullptr; el = el->next_.load(std::memory_order_relaxed)) {
+      if (el->id() == id) { return el; }
+    }
+    return nullptr;
+  }
+
+  // A clashing descriptor is in no bucket, so its next_ links it into the list of collisions instead.
+  void add_collision(ErrorDescriptor &descriptor)
+  {
+    const ErrorDescriptor *expected = collisions_.load(std::memory_order_acquire);
+    do {
+      descriptor.next_.store(expected, std::memory_order_relaxed);
+    } while (!collisions_.compare_exchange_weak(
+      expected, &descriptor, std::memory_order_release, std::memory_order_acquire));
+  }
+
+  std::array<std::atomic<const ErrorDescriptor *>, bucket_count> buckets_{};
+  std::atomic<const ErrorDescriptor *> collisions_{ nullptr };
+};
+
+/// @brief The process wide registry
+inline constinit ErrorRegistry error_registry{};
+
+namespace detail {
+  template<typename E> constexpr std::string_view error_name()
+  {
+    if constexpr (requires { E::static_name; }) {
+      return E::static_name;
+    } else {
+      return type_name<E>();
+    }
+  }
+
+  template<typename E> constexpr Severity error_severity()
+  {
+    if constexpr (requires { E::severity; }) {
+      return E::severity;
+    } else {
+      return Severity::error;
+    }
+  }
+
+  template<typename E> struct Registration
+  {
+    static constinit inline ErrorDescriptor descriptor{
+      static_id_v<E>, error_name<E>(), E::static_message, error_severity<E>()
+    };
+  };
+}// namespace detail
+
+/**
+ * @brief Descriptor of an error type that declares its message at compile time (f.e. by deriving from WithStaticId).
+ *        The type is added to error_registry on first use. Name and severity are taken from the optional members
+ *        static constexpr std::string_view static_name and static constexpr Severity severity, by default the name
+ *        is the type name and the severity is Severity::error.
+ *        If another type or descriptor with the same id was added before, the descriptor of E is not added but listed
+ *        by error_registry.for_each_collision.
+ *
+ * @tparam E Error type
+ * @return const ErrorDescriptor&
+ */
+template<typename E>
+  requires requires { E::static_message; }
+const ErrorDescriptor &describe()
+{
+  // Adds once per type, a clash is recorded by the registry.
+  static const bool registered [[maybe_unused]] = error_registry.add(detail::Registration<E>::descriptor);
+  return detail::Registration<E>::descriptor;
+}
+
+}// namespace anywho
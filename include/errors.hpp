@@ -1,92 +1,392 @@
 #pragma once
 
 #include "context.hpp"
+#include "error_id.hpp"
+#include "error_registry.hpp"
+#include "fixed_string.hpp"
+#include "metrics.hpp"
+#include "scoped_context.hpp"
+#include "small_vector.hpp"
+#include "stacktrace.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iterator>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <system_error>
+#include <type_traits>
 #include <vector>
 
 namespace anywho {
 
 /**
- * @brief Most basic form of an error. Use it directly or inherit from it to specialize your errors.
- *        Uses dynamic memory allocation.
+ * @brief Most basic form of an error. Use it directly (as GenericError) or inherit from it to specialize your errors.
+ *        The first InlineContexts contexts are stored inside the error, only longer chains allocate.
+ *        GenericError stores all contexts on the heap, which keeps the error small for the happy path.
+ *        On construction the breadcrumbs of active ScopedContext guards are added as contexts.
+ *        The chain grows without limit, unless the error type declares a ContextPolicy context_policy member. The
+ *        member is read by the std::type_identity constructor, which WithStaticId calls. A type that derives from
+ *        GenericError directly and declares a policy fails to compile once it is propagated or given context.
  *
+ * @tparam InlineContexts Number of contexts that are stored without dynamic memory allocation
  */
-class GenericError
+template<std::size_t InlineContexts> class [[gnu::visibility("default")]] BasicGenericError
 {
 public:
-  virtual ~GenericError() = default;
+  using ContextChain =
+    std::conditional_t<InlineContexts == 0, std::vector<Context>, SmallVector<Context, InlineContexts>>;
+
+  BasicGenericError() : BasicGenericError(std::type_identity<BasicGenericError>{}) {}
+  BasicGenericError(const BasicGenericError &) = default;
+  BasicGenericError(BasicGenericError &&) noexcept = default;
+  BasicGenericError &operator=(const BasicGenericError &) = default;
+  BasicGenericError &operator=(BasicGenericError &&) noexcept = default;
+  virtual ~BasicGenericError() = default;
 
   [[nodiscard]] std::string format() const
   {
-    // This would be nicer with ranges like but we would need more deps
-    // #include <algorithm>
-    // #include <ranges>
-    //     return std::ranges::fold_left(contexts_ | std::views::transform([](const auto &el) { return "::" +
-    //     el.format(); }),
-    //              "",
-    //              std::plus<std::string>())
-    //            | std::views::drop(2);
-    std::string out = message();
-    for (const auto &el : contexts_) { out += "::" + el.format(); }
+    std::string out;
+    format_to(std::back_inserter(out));
 
     return out;
   }
 
-  void consume_context(anywho::Context &&context) { contexts_.emplace_back(std::move(context)); }
+  /**
+   * @brief Write the formatted error to an output iterator without building intermediate strings for the contexts.
+   *
+   * @tparam OutputIt Output iterator of char, f.e. std::back_insert_iterator or the iterator of a format context
+   * @param out Where to write to
+   * @return OutputIt Iterator past the last written char
+   */
+  template<typename OutputIt> OutputIt format_to(OutputIt out) const
+  {
+    out = std::ranges::copy(message(), out).out;
+
+    return contexts_to(out);
+  }
+
+  void consume_context(anywho::Context &&context)
+  {
+    if constexpr (metrics::enabled) { probe_.context([this] { return id(); }); }
+    detail::add_context(contexts_, context_policy_, std::move(context));
+  }
+  /// @brief Add the breadcrumbs of active ScopedContext guards that were not added yet
+  void capture_breadcrumbs()
+  {
+    breadcrumbs_.capture(
+      [this](Context &&context) { detail::add_context(contexts_, context_policy_, std::move(context)); });
+  }
+  /// @brief Called by ANYWHO and with_context on every hop
+  void on_propagation()
+  {
+    capture_breadcrumbs();
+    if constexpr (metrics::enabled) { probe_.propagated([this] { return id(); }); }
+  }
+
   // This can be constexpr in c++20
   [[nodiscard]] virtual std::string message() const { return "generic error happened"; }
-  [[nodiscard]] virtual size_t id() const { return std::hash<std::string>{}(message()); }
+  /// @brief Errors that derive from WithStaticId return a compile time constant, others hash message() at runtime.
+  [[nodiscard]] virtual ErrorId id() const { return hash_id(message()); }
+  /// @brief type_key_v of the dynamic type for match, is and as. Overridden by WithStaticId and the errors of anywho.
+  [[nodiscard]] virtual TypeKey type_key() const { return type_key_v<BasicGenericError>; }
+
+  [[nodiscard]] const ContextChain &contexts() const { return contexts_; }
+  /// @brief Stack the error was created on, empty unless ANYWHO_ENABLE_STACKTRACE is set. Not part of format()
+  [[nodiscard]] const StackTrace &stacktrace() const { return stack_; }
 
 protected:
-  std::vector<Context> contexts_{};
+  /// @brief Captures the stack and bounds the contexts as stack_policy and context_policy of Policy say
+  template<typename Policy>
+  explicit BasicGenericError(std::type_identity<Policy> /*policy*/)
+    : context_policy_{ detail::context_policy<Policy>() }
+  {
+    // WithStaticId counts errors with a static id itself.
+    if constexpr (metrics::enabled && !requires { Policy::static_message; }) { probe_.created_without_id(); }
+    capture_breadcrumbs();
+    detail::capture_stack<Policy>(stack_);
+  }
+
+  /// @brief Write the contexts as format_to does after the message
+  template<typename OutputIt> OutputIt contexts_to(OutputIt out) const
+  {
+    for (const auto &el : contexts_) {
+      out = std::ranges::copy(std::string_view{ "::" }, out).out;
+      out = el.format_to(out);
+    }
+
+    return out;
+  }
+
+  ContextChain contexts_{};
+  [[no_unique_address]] metrics::Probe probe_{};
+
+private:
+  ContextPolicy context_policy_{ ContextPolicy::keep_all() };
+  BreadcrumbMark breadcrumbs_{};
+  [[no_unique_address]] StackTrace stack_{};
 };
 
+/// @brief Error that stores its contexts on the heap.
+using GenericError = BasicGenericError<0>;
+
 /**
  * @brief Error without dynamic memory allocation. Can be used as a base for custom errors.
- *        Context that is longer than the specified size will be ommitted.
+ *        Contexts are appended in place to a fixed buffer. Context that does not fit anymore is dropped and
+ *        truncated() is set.
+ *        Adding contexts never allocates, neither do breadcrumbs of ScopedContext guards without format arguments.
+ *        Note that message() returns a std::string, which allocates for messages that do not fit the small string
+ *        buffer, so format it outside of allocation free code paths.
  *
  * @tparam Size Maximum size of the resulting error message
  */
-template<uint Size> class FixedSizeError
+template<uint Size> class [[gnu::visibility("default")]] FixedSizeError
 {
 public:
+  FixedSizeError() : FixedSizeError(std::type_identity<FixedSizeError>{}) {}
+  FixedSizeError(const FixedSizeError &) = default;
+  FixedSizeError(FixedSizeError &&) noexcept = default;
+  FixedSizeError &operator=(const FixedSizeError &) = default;
+  FixedSizeError &operator=(FixedSizeError &&) noexcept = default;
   virtual ~FixedSizeError() = default;
 
-  [[nodiscard]] std::string format() const { return message() + static_cast<std::string>(message_); }
+  [[nodiscard]] std::string format() const
+  {
+    std::string out;
+    format_to(std::back_inserter(out));
+
+    return out;
+  }
+
+  /**
+   * @brief Write the formatted error to an output iterator.
+   *
+   * @tparam OutputIt Output iterator of char
+   * @param out Where to write to
+   * @return OutputIt Iterator past the last written char
+   */
+  template<typename OutputIt> OutputIt format_to(OutputIt out) const
+  {
+    out = std::ranges::copy(message(), out).out;
+
+    return std::ranges::copy(context_view(), out).out;
+  }
 
   void consume_context(anywho::Context &&context)
   {
-    message_ = format_ns::format("{}::{}", static_cast<std::string>(message_), context.format());
+    if constexpr (metrics::enabled) { probe_.context([this] { return id(); }); }
+    append(context);
+  }
+  /// @brief Add the breadcrumbs of active ScopedContext guards that were not added yet
+  void capture_breadcrumbs() { breadcrumbs_.capture([this](Context &&context) { append(context); }); }
+  /// @brief Called by ANYWHO and with_context on every hop
+  void on_propagation()
+  {
+    capture_breadcrumbs();
+    if constexpr (metrics::enabled) { probe_.propagated([this] { return id(); }); }
   }
 
   // This can be constexpr in c++20
   [[nodiscard]] virtual std::string message() const { return "fixed size error happened"; }
-  [[nodiscard]] virtual size_t id() const { return std::hash<std::string>{}(message()); }
+  /// @brief Errors that derive from WithStaticId return a compile time constant, others hash message() at runtime.
+  [[nodiscard]] virtual ErrorId id() const { return hash_id(message()); }
+  /// @brief type_key_v of the dynamic type for match, is and as. Overridden by WithStaticId.
+  [[nodiscard]] virtual TypeKey type_key() const { return type_key_v<FixedSizeError>; }
+
+  /// @brief All contexts added so far, formatted
+  [[nodiscard]] std::string_view context_view() const { return message_.view(); }
+  /// @brief True if contexts were dropped because the buffer was full
+  [[nodiscard]] bool truncated() const { return message_.truncated(); }
+  /// @brief Stack the error was created on, empty unless ANYWHO_ENABLE_STACKTRACE is set. Not part of format()
+  [[nodiscard]] const StackTrace &stacktrace() const { return stack_; }
+
+protected:
+  /// @brief Captures the stack as the stack_policy of Policy says
+  template<typename Policy> explicit FixedSizeError(std::type_identity<Policy> /*policy*/)
+  {
+    if constexpr (metrics::enabled && !requires { Policy::static_message; }) { probe_.created_without_id(); }
+    capture_breadcrumbs();
+    detail::capture_stack<Policy>(stack_);
+  }
+
+  [[no_unique_address]] metrics::Probe probe_{};
 
 private:
+  void append(const Context &context)
+  {
+    if (message_.truncated()) { return; }
+
+    message_.append_with([&context](TruncatingIterator out) {
+      out = std::ranges::copy(std::string_view{ "::" }, out).out;
+      return context.format_to(out);
+    });
+  }
+
   FixedString<Size> message_{};
+  BreadcrumbMark breadcrumbs_{};
+  [[no_unique_address]] StackTrace stack_{};
+};
+
+/**
+ * @brief Base for errors whose message is known at compile time. id() then returns a constant instead of hashing
+ *        message() on every call.
+ *        Use like
+ *        class IOError final : public anywho::WithStaticId<IOError>
+ *        {
+ *        public:
+ *          static constexpr std::string_view static_message{ "IO error happened" };
+ *        };
+ *        or with anywho::WithStaticId<IOError, anywho::FixedSizeError<1024>> for errors without dynamic memory.
+ *        Collisions can be checked at compile time with anywho::unique_ids.
+ *        descriptor() adds the type to the error_registry, so that its id can be resolved without an error object.
+ *        A static constexpr StackPolicy stack_policy member decides how often the type captures a stack trace, a
+ *        static constexpr ContextPolicy context_policy member how many contexts a GenericError based type keeps.
+ *        Error types can derive from each other, match, is and as then accept the derived errors as the base:
+ *        class StorageError : public anywho::WithStaticId<StorageError>
+ *        {
+ *        public:
+ *          using WithStaticId::WithStaticId;
+ *          static constexpr std::string_view static_message{ "storage error" };
+ *        };
+ *        class DiskFullError final : public anywho::WithStaticId<DiskFullError, StorageError> { ... };
+ *        The base inherits the constructors, so that the derived type passes its own policies down.
+ *
+ * @tparam Derived The error that is defined, must declare static constexpr std::string_view static_message
+ * @tparam Base GenericError, FixedSizeError or another error type derived from WithStaticId
+ */
+template<typename Derived, typename Base = GenericError> class WithStaticId : public Base
+{
+public:
+  /// @brief Next error type up the hierarchy, which match, is and as also accept the error as
+  using base_error = Base;
+  /// @brief Type whose context_policy and stack_policy the constructor applies
+  using policy_owner = Derived;
+
+  using Base::Base;
+  WithStaticId() : Base(std::type_identity<Derived>{}) {}
+
+  [[nodiscard]] std::string message() const override { return std::string{ Derived::static_message }; }
+  [[nodiscard]] ErrorId id() const override { return static_id_v<Derived>; }
+  [[nodiscard]] TypeKey type_key() const override { return type_key_v<Derived>; }
+  /// @brief Id, name, message and severity of the error type, registered on first use
+  [[nodiscard]] static const ErrorDescriptor &descriptor() { return describe<Derived>(); }
+
+protected:
+  /// @brief Used by error types that derive from Derived, which count themselves and bring their own policies
+  template<typename Policy>
+  explicit WithStaticId(std::type_identity<Policy> policy) : Base(policy), count_creation_{ nullptr }
+  {}
+
+private:
+  /// @brief Counts the error as soon as it is constructed, since its id is known statically
+  struct CountCreation
+  {
+    explicit CountCreation([[maybe_unused]] WithStaticId *error)
+    {
+      if constexpr (metrics::enabled) {
+        if (error != nullptr) { error->probe_.created(static_id_v<Derived>); }
+      }
+    }
+  };
+  [[no_unique_address]] CountCreation count_creation_{ this };
 };
 
 /**
- * @brief Error class that is used for functions that return std::error_code
+ * @brief Error class that is used for functions that return std::error_code.
+ *        The id is computed on construction from the name of the category and the value, so it neither depends on
+ *        the locale nor needs the message. The message is only built when it is asked for, format_to writes it
+ *        straight into the output.
  *
  */
-class ErrorFromCode final : public GenericError
+class [[gnu::visibility("default")]] ErrorFromCode final : public GenericError
 {
 public:
-  ErrorFromCode(const std::error_code &code) : code_{ code } {}
-  ErrorFromCode(std::error_code &&code) : code_{ std::move(code) } {}
+  using base_error = GenericError;
+
+  ErrorFromCode(const std::error_code &code)
+    : GenericError(std::type_identity<ErrorFromCode>{}), code_{ code }, id_{ id_of(code) }
+  {}
+  ErrorFromCode(std::error_code &&code)
+    : GenericError(std::type_identity<ErrorFromCode>{}), code_{ std::move(code) }, id_{ id_of(code_) }
+  {}
+
+  /**
+   * @brief Id of the errors with a code of the category and value, at compile time f.e.
+   *        static_assert(anywho::ErrorFromCode::id_of("generic", ENOENT) != 0);
+   *
+   * @param category_name What name() of the category returns
+   * @param value Value of the code
+   * @return ErrorId
+   */
+  static constexpr ErrorId id_of(std::string_view category_name, int value)
+  {
+    const auto bits = static_cast<std::uint32_t>(value);
+    const std::array<char, 4> bytes{ static_cast<char>(bits & 0xffU),
+      static_cast<char>((bits >> 8U) & 0xffU),
+      static_cast<char>((bits >> 16U) & 0xffU),
+      static_cast<char>(bits >> 24U) };
+    return hash_id(std::string_view{ bytes.data(), bytes.size() }, hash_id(category_name));
+  }
+  static ErrorId id_of(const std::error_code &code) { return id_of(code.category().name(), code.value()); }
+
   // This can be constexpr in c++20
   [[nodiscard]] std::string message() const override
   {
-    return format_ns::format("error happened with code {} and message {}", code_.value(), code_.message());
+    std::string out;
+    message_to(std::back_inserter(out));
+
+    return out;
+  }
+  [[nodiscard]] ErrorId id() const override { return id_; }
+  [[nodiscard]] TypeKey type_key() const override { return type_key_v<ErrorFromCode>; }
+
+  /// @brief Write the message to an output iterator, without building it as a string first
+  template<typename OutputIt> OutputIt message_to(OutputIt out) const
+  {
+    return format_ns::format_to(out, "error happened with code {} and message {}", code_.value(), code_.message());
+  }
+
+  [[nodiscard]] std::string format() const
+  {
+    std::string out;
+    format_to(std::back_inserter(out));
+
+    return out;
   }
 
+  template<typename OutputIt> OutputIt format_to(OutputIt out) const { return contexts_to(message_to(out)); }
+
   [[nodiscard]] const std::error_code &get_code() const { return code_; }
 
 private:
   std::error_code code_;
+  ErrorId id_;
+};
+}// namespace anywho
+
+namespace anywho::detail {
+template<std::size_t N> std::true_type is_generic_error_impl(const BasicGenericError<N> *);
+std::false_type is_generic_error_impl(...);
+template<uint Size> std::true_type is_fixed_size_error_impl(const FixedSizeError<Size> *);
+std::false_type is_fixed_size_error_impl(...);
+
+/// @brief True for BasicGenericError, FixedSizeError and everything derived from them
+template<typename E>
+concept FormattableError = decltype(is_generic_error_impl(std::declval<const E *>()))::value
+                           || decltype(is_fixed_size_error_impl(std::declval<const E *>()))::value;
+}// namespace anywho::detail
+
+/**
+ * @brief Formatter for GenericError, FixedSizeError, ErrorFromCode and all errors derived from them, so they can be
+ *        written straight into a buffer like
+ *        std::format_to(std::back_inserter(log_buffer), "request failed: {}", error);
+ *
+ * @tparam E Error type
+ */
+template<anywho::detail::FormattableError E> struct anywho::format_ns::formatter<E, char>
+{
+  constexpr auto parse(auto &ctx) { return ctx.begin(); }
+
+  auto format(const E &error, auto &ctx) const { return error.format_to(ctx.out()); }
 };
-}// namespace anywho
\ No newline at end of file
@@ -1,82 +1,250 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
-#include <cstring>
+#include <cstddef>
+#include <compare>
+#include <functional>
+#include <iterator>
 #include <string>
+#include <string_view>
+#include <utility>
 
 namespace anywho {
 
 /**
- * @brief FixedString without dynamic memory allocation
+ * @brief Output iterator that writes into a char range and drops everything past its end instead of overflowing.
+ *        Used to append to fixed size buffers without dynamic memory allocation.
  *
- * @tparam N Maximum length of the string
  */
-template<size_t N> class FixedString final
+class TruncatingIterator final
 {
+public:
+  using iterator_category = std::output_iterator_tag;
+  using value_type = void;
+  using difference_type = std::ptrdiff_t;
+  using pointer = void;
+  using reference = void;
+
+  constexpr TruncatingIterator() = default;
+  constexpr TruncatingIterator(char *pos, char *end) : pos_{ pos }, end_{ end } {}
+
+  constexpr TruncatingIterator &operator=(char value)
+  {
+    if (pos_ != end_) {
+      *pos_++ = value;
+    } else {
+      truncated_ = true;
+    }
+    return *this;
+  }
+
+  constexpr TruncatingIterator &operator*() { return *this; }
+  constexpr TruncatingIterator &operator++() { return *this; }
+  constexpr TruncatingIterator &operator++(int) { return *this; }
+
+  /// @brief Position after the last written char
+  [[nodiscard]] constexpr char *position() const { return pos_; }
+  /// @brief True if at least one char was dropped
+  [[nodiscard]] constexpr bool truncated() const { return truncated_; }
+
 private:
-  std::array<char, N> data{};
+  char *pos_{ nullptr };
+  char *end_{ nullptr };
+  bool truncated_{ false };
+};
+
+/**
+ * @brief FixedString without dynamic memory allocation. Stores its length, so conversion to std::string_view,
+ *        copies and appends only touch the used part of the buffer. Everything is constexpr.
+ *        Input that does not fit is cut off and truncated() is set.
+ *
+ * @tparam N Size of the buffer including the terminating zero, hence the maximum length is N - 1
+ */
+template<size_t N> class FixedString final
+{
+  static_assert(N > 0, "FixedString needs space for the terminating zero");
 
 public:
-  FixedString() { data[0] = '\0'; }
+  constexpr FixedString()
+  {
+    init_storage();
+    data_[0] = '\0';
+  }
 
+  constexpr FixedString(const FixedString &other) : size_{ other.size_ }, truncated_{ other.truncated_ }
+  {
+    init_storage();
+    std::copy_n(other.data_.data(), size_ + 1, data_.data());
+  }
 
-  FixedString(const FixedString &other) { data = other.data; }
+  constexpr FixedString(FixedString &&other) noexcept : FixedString(std::as_const(other)) {}
 
-  FixedString(FixedString &&other) noexcept : data(std::move(other.data)) {}
+  constexpr FixedString(std::string_view str)
+  {
+    init_storage();
+    assign(str);
+  }
+  constexpr FixedString(const std::string &str) : FixedString(std::string_view{ str }) {}
+  constexpr FixedString(const char *str) : FixedString(std::string_view{ str }) {}
 
-  FixedString(const std::string &str) { assign(str); }
-  FixedString(const char *str) { assign(str); }
+  constexpr ~FixedString() = default;
 
-  ~FixedString() = default;
+  constexpr FixedString &operator=(FixedString &&other) noexcept { return *this = std::as_const(other); }
 
-  FixedString &operator=(FixedString &&other) noexcept
+  constexpr FixedString &operator=(const FixedString &other)
   {
-    if (this != &other) { data = std::move(other.data); }
+    if (this != &other) {
+      size_ = other.size_;
+      truncated_ = other.truncated_;
+      std::copy_n(other.data_.data(), size_ + 1, data_.data());
+    }
 
     return *this;
   }
 
-  FixedString &operator=(const FixedString &other)
+  constexpr FixedString &operator=(std::string_view str)
   {
-    if (this != &other) { data = other.data; }
+    assign(str);
 
     return *this;
   }
 
-  FixedString &operator=(const std::string &str)
+  constexpr FixedString &operator=(const std::string &str)
   {
     assign(str);
 
     return *this;
   }
 
-  FixedString &operator=(const char *str)
+  constexpr FixedString &operator=(const char *str)
   {
     assign(str);
 
     return *this;
   }
 
-  const char &operator[](size_t index) const { return data[index]; }
+  constexpr const char &operator[](size_t index) const { return data_[index]; }
+
+  constexpr char &operator[](size_t index) { return data_[index]; }
+
+  constexpr operator std::string_view() const { return view(); }
+
+  operator std::string() const { return std::string{ view() }; }
 
-  char &operator[](size_t index) { return data[index]; }
+  [[nodiscard]] constexpr std::string_view view() const { return { data_.data(), size_ }; }
+  [[nodiscard]] constexpr const char *c_str() const { return data_.data(); }
+  [[nodiscard]] constexpr size_t size() const { return size_; }
+  [[nodiscard]] constexpr bool empty() const { return size_ == 0; }
+  [[nodiscard]] static constexpr size_t capacity() { return N - 1; }
+  /// @brief True if input had to be cut off because it did not fit
+  [[nodiscard]] constexpr bool truncated() const { return truncated_; }
 
-  operator std::string() const { return std::string(data.data()); }
+  constexpr void clear()
+  {
+    size_ = 0;
+    truncated_ = false;
+    data_[0] = '\0';
+  }
+
+  /**
+   * @brief Append as much of str as fits.
+   *
+   * @param str String to append
+   * @return true if str was appended completely
+   */
+  constexpr bool append(std::string_view str)
+  {
+    const size_t count = std::min(str.size(), capacity() - size_);
+    std::copy_n(str.data(), count, data_.data() + size_);
+    size_ += count;
+    data_[size_] = '\0';
+    truncated_ = truncated_ || count < str.size();
+
+    return count == str.size();
+  }
+
+  constexpr FixedString &operator+=(std::string_view str)
+  {
+    append(str);
+
+    return *this;
+  }
+
+  /**
+   * @brief Append by writing to a TruncatingIterator, f.e. with Context::format_to. Never writes past the buffer.
+   *
+   * @tparam Writer Callable taking a TruncatingIterator and returning it after writing
+   * @param writer Callable that writes the text to append
+   * @return true if nothing was cut off
+   */
+  template<typename Writer> constexpr bool append_with(Writer &&writer)
+  {
+    TruncatingIterator out{ data_.data() + size_, data_.data() + capacity() };
+    out = std::forward<Writer>(writer)(out);
+    size_ = static_cast<size_t>(out.position() - data_.data());
+    data_[size_] = '\0';
+    truncated_ = truncated_ || out.truncated();
+
+    return !out.truncated();
+  }
+
+  template<size_t M> [[nodiscard]] constexpr bool operator==(const FixedString<M> &other) const
+  {
+    return view() == other.view();
+  }
+  [[nodiscard]] constexpr bool operator==(std::string_view other) const { return view() == other; }
+  [[nodiscard]] constexpr bool operator==(const char *other) const { return view() == other; }
+
+  template<size_t M> [[nodiscard]] constexpr auto operator<=>(const FixedString<M> &other) const
+  {
+    return view() <=> other.view();
+  }
+  [[nodiscard]] constexpr auto operator<=>(std::string_view other) const { return view() <=> other; }
 
 private:
-  void assign(const std::string &str)
+  /// @brief Constant evaluation does not allow indeterminate values, at runtime the buffer stays untouched.
+  constexpr void init_storage()
   {
-    const size_t max_index = std::min(str.size(), N - 1);
-    for (size_t i = 0; i < max_index; ++i) { data[i] = str[i]; }
-    data[max_index] = '\0';
+    if consteval { data_.fill('\0'); }
   }
 
-  void assign(const char *str)
+  constexpr void assign(std::string_view str)
   {
-    const size_t max_index = std::min(strlen(str), N - 1);
-    for (size_t i = 0; i < max_index; ++i) { data[i] = str[i]; }
-    data[max_index] = '\0';
+    size_ = std::min(str.size(), capacity());
+    truncated_ = size_ < str.size();
+    std::copy_n(str.data(), size_, data_.data());
+    data_[size_] = '\0';
   }
+
+  // Deliberately not value initialized, only the used part and the terminating zero are ever written or read.
+  std::array<char, N> data_;
+  size_t size_{ 0 };
+  bool truncated_{ false };
+};
+
+/**
+ * @brief String literal that can be a non-type template parameter, f.e. of StaticError<"IOError">. FixedString can
+ *        not be one, since template parameters must not have private members.
+ *
+ * @tparam N Size of the literal including the terminating zero
+ */
+template<size_t N> struct StringLiteral
+{
+  // Implicit, so that a plain literal can be the template argument
+  consteval StringLiteral(const char (&str)[N]) { std::copy_n(str, N, data.begin()); }
+
+  [[nodiscard]] constexpr std::string_view view() const { return { data.data(), N - 1 }; }
+
+  std::array<char, N> data{};
 };
 
-}// namespace anywho
\ No newline at end of file
+}// namespace anywho
+
+template<size_t N> struct std::hash<anywho::FixedString<N>>
+{
+  size_t operator()(const anywho::FixedString<N> &str) const noexcept
+  {
+    return std::hash<std::string_view>{}(str.view());
+  }
+};
@@ -1,6 +1,7 @@
 #pragma once
 #include <expected>
 #include <optional>
+#include <type_traits>
 namespace anywho {
 
 // We might want to use the concepts here but than we could not represent error as strings or other types...
@@ -8,5 +9,14 @@ template<typename E> inline bool has_error(const std::optional<E> &x) { return x
 
 #if __cplusplus > 202002L
 template<typename T, typename E> inline bool has_error(const std::expected<T, E> &x) { return !x.has_value(); }
+
+namespace detail {
+  template<typename T> struct IsExpected : std::false_type
+  {
+  };
+  template<typename T, typename E> struct IsExpected<std::expected<T, E>> : std::true_type
+  {
+  };
+}// namespace detail
 #endif
 }// namespace anywho
\ No newline at end of file
@@ -0,0 +1,203 @@
+#pragma once
+
+#include "any_error.hpp"
+#include "error_id.hpp"
+#include <concepts>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+namespace anywho {
+
+/**
+ * @brief type_key_v of the dynamic type of an error: type_key() for the error base classes and anywho::Error, the
+ *        static type for everything else.
+ *
+ * @tparam Err Error type
+ * @param error Error to look at
+ * @return TypeKey
+ */
+template<typename Err> constexpr TypeKey type_key_of(const Err &error)
+{
+  if constexpr (requires {
+                  { error.type_key() } -> std::same_as<TypeKey>;
+                }) {
+    return error.type_key();
+  } else {
+    return type_key_v<Err>;
+  }
+}
+
+namespace detail {
+  /// @brief Whether an error of static type Err can be an E at all
+  template<typename E, typename Err>
+  concept MaybeA = std::derived_from<Err, E> || std::derived_from<E, Err>;
+
+  /// @brief Whether an error of static type Err and dynamic type key type is or derives from an E
+  template<typename E, typename Err> constexpr bool is_type(TypeKey type)
+  {
+    if constexpr (std::derived_from<Err, E>) {
+      return true;
+    } else if constexpr (MaybeA<E, Err>) {
+      return derives_from<E>(type);
+    } else {
+      return false;
+    }
+  }
+
+  /// @brief Error as E, after is_type said it is one
+  template<typename E, typename Err> auto &cast_to(Err &error)
+  {
+    return static_cast<std::conditional_t<std::is_const_v<Err>, const E, E> &>(error);
+  }
+
+  template<typename F> struct HandlerParameter;
+  template<typename R, typename A> struct HandlerParameter<R (*)(A)>
+  {
+    using type = std::remove_cvref_t<A>;
+  };
+  template<typename R, typename A> struct HandlerParameter<R (*)(A) noexcept> : HandlerParameter<R (*)(A)>
+  {
+  };
+  template<typename C, typename R, typename A> struct HandlerParameter<R (C::*)(A)> : HandlerParameter<R (*)(A)>
+  {
+  };
+  template<typename C, typename R, typename A>
+  struct HandlerParameter<R (C::*)(A) const> : HandlerParameter<R (*)(A)>
+  {
+  };
+  template<typename C, typename R, typename A>
+  struct HandlerParameter<R (C::*)(A) noexcept> : HandlerParameter<R (*)(A)>
+  {
+  };
+  template<typename C, typename R, typename A>
+  struct HandlerParameter<R (C::*)(A) const noexcept> : HandlerParameter<R (*)(A)>
+  {
+  };
+
+  template<typename F>
+  concept FunctionPointer = std::is_pointer_v<F> && std::is_function_v<std::remove_pointer_t<F>>;
+
+  /// @brief Handler with one parameter of a fixed type, which selects the errors it is called for
+  template<typename F>
+  concept TypedHandler = requires { typename HandlerParameter<F>::type; }
+                         || requires { typename HandlerParameter<decltype(&F::operator())>::type; };
+
+  template<typename F> struct ParameterOf
+  {
+    using type = typename HandlerParameter<decltype(&F::operator())>::type;
+  };
+  template<FunctionPointer F> struct ParameterOf<F>
+  {
+    using type = typename HandlerParameter<F>::type;
+  };
+  template<typename F> using parameter_t = typename ParameterOf<F>::type;
+
+  template<typename Err, typename F> struct HandlerResult
+  {
+    using type = std::invoke_result_t<F &, Err &>;
+  };
+  template<typename Err, TypedHandler F> struct HandlerResult<Err, F>
+  {
+    using Parameter = std::conditional_t<std::is_const_v<Err>, const parameter_t<F>, parameter_t<F>>;
+    using type = std::invoke_result_t<F &, Parameter &>;
+  };
+  template<typename Err, typename F>
+    requires(!TypedHandler<F> && std::invocable<F &>)
+  struct HandlerResult<Err, F>
+  {
+    using type = std::invoke_result_t<F &>;
+  };
+
+  template<typename R, typename Err, typename H, typename... Rest>
+  R match_from(TypeKey type, Err &error, H &handler, Rest &...rest)
+  {
+    if constexpr (TypedHandler<H>) {
+      using P = parameter_t<H>;
+      using Static = std::remove_const_t<Err>;
+      if constexpr (std::derived_from<Static, P>) {
+        return std::invoke(handler, cast_to<P>(error));
+      } else {
+        if constexpr (std::same_as<Static, Error>) {
+          if (auto *held = error.template downcast<P>()) { return std::invoke(handler, *held); }
+        } else if constexpr (MaybeA<P, Static>) {
+          if (derives_from<P>(type)) { return std::invoke(handler, cast_to<P>(error)); }
+        }
+        if constexpr (sizeof...(Rest) > 0) {
+          return match_from<R>(type, error, rest...);
+        } else {
+          static_assert(std::is_void_v<R>, "match with a result needs a last handler for all errors");
+        }
+      }
+    } else if constexpr (std::invocable<H &>) {
+      return std::invoke(handler);
+    } else {
+      return std::invoke(handler, error);
+    }
+  }
+}// namespace detail
+
+/**
+ * @brief True if the error is an E, without RTTI: errors whose static type derives from E always are, otherwise the
+ *        dynamic type must be E or derive from it, see derives_from. For GenericError and FixedSizeError hierarchies
+ *        the dynamic type is known for WithStaticId and the errors of anywho, for anywho::Error it is the held type.
+ *
+ * @tparam E Type to check for
+ * @tparam Err Static type of the error
+ * @param error Error to check
+ */
+template<typename E, typename Err> constexpr bool is(const Err &error)
+{
+  if constexpr (std::same_as<Err, Error> && !std::same_as<E, Error>) {
+    return error.template is<E>();
+  } else {
+    return detail::is_type<E, Err>(type_key_of(error));
+  }
+}
+
+/**
+ * @brief The error as E if is<E> holds, like dynamic_cast without RTTI.
+ *
+ * @tparam E Type to cast to
+ * @tparam Err Static type of the error
+ * @param error Error to cast
+ * @return E* or const E*, nullptr if the error is no E
+ */
+template<typename E, typename Err> auto *as(Err &error)
+{
+  using Target = std::conditional_t<std::is_const_v<Err>, const E, E>;
+  if constexpr (std::same_as<std::remove_const_t<Err>, Error> && !std::same_as<E, Error>) {
+    return error.template downcast<E>();
+  } else if constexpr (detail::MaybeA<E, std::remove_const_t<Err>>) {
+    if (is<E>(error)) { return &detail::cast_to<E>(error); }
+  }
+  return static_cast<Target *>(nullptr);
+}
+
+/**
+ * @brief Call the first handler that takes the error, like consecutive catch clauses but without RTTI.
+ *        Handlers with one parameter of type P are taken if is<P>(error), handlers without parameter and generic ones
+ *        take every error. The dynamic type key is read once, each handler for a final type then costs a compare
+ *        with a constant address, other handlers walk the keys from the dynamic type up its base_error types. For
+ *        anywho::Error the handlers are tried with downcast, which compares the same keys.
+ *        anywho::match(error,
+ *          [](const IOError &io) { return retry(io); },
+ *          [](const anywho::ErrorFromCode &code) { return report(code.get_code()); },
+ *          [] { return give_up(); });
+ *        Handlers that return something need a last handler that takes every error.
+ *
+ * @param error Error to dispatch, f.e. a GenericError, a FixedSizeError or an anywho::Error
+ * @param handlers Callables to try in order
+ * @return Common type of the results of the handlers
+ */
+template<typename Err, typename... Handlers>
+  requires(sizeof...(Handlers) > 0)
+decltype(auto) match(Err &&error, Handlers &&...handlers)
+{
+  using Static = std::remove_reference_t<Err>;
+  using Result = std::common_type_t<typename detail::HandlerResult<Static, std::remove_cvref_t<Handlers>>::type...>;
+
+  return detail::match_from<Result>(type_key_of(error), error, handlers...);
+}
+
+}// namespace anywho
@@ -0,0 +1,316 @@
+#pragma once
+
+#include "error_id.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * Counting errors is opt-in. Define ANYWHO_ENABLE_METRICS to 1 for the whole program (the CMake option
+ * anywho_ENABLE_METRICS does so), otherwise all probes are empty and every hook compiles to nothing.
+ */
+#ifndef ANYWHO_ENABLE_METRICS
+#define ANYWHO_ENABLE_METRICS 0
+#endif
+
+namespace anywho::metrics {
+
+/// @brief Number of distinct error ids each thread can count, further ids are only counted as dropped
+inline constexpr std::size_t ids_per_thread{ 64 };
+/// @brief Number of threads that count at the same time, further threads are only counted as dropped
+inline constexpr std::size_t max_threads{ 64 };
+/// @brief Buckets of the propagation depth histogram, the last one collects all deeper errors
+inline constexpr std::size_t depth_buckets{ 16 };
+
+/// @brief Counts of one error id, summed over all threads
+struct ErrorCount
+{
+  ErrorId id{ 0 };
+  /// @brief Errors created with the id, or identified as it on their first context or hop
+  std::uint64_t created{ 0 };
+  /// @brief Hops through ANYWHO, ANYWHO_OPT and with_context
+  std::uint64_t propagated{ 0 };
+  /// @brief Contexts added through consume_context
+  std::uint64_t contexts{ 0 };
+};
+
+/// @brief Everything counted so far, as plain data for metrics exporters
+struct Snapshot
+{
+  /// @brief Sorted by id
+  std::vector<ErrorCount> errors;
+  /// @brief Number of errors by how often they were propagated until they were destroyed
+  std::array<std::uint64_t, depth_buckets> depth_histogram{};
+  /// @brief Events that could not be counted because a thread counted too many ids or too many threads counted
+  std::uint64_t dropped{ 0 };
+  /// @brief Errors without a static id that were never given a context nor propagated, so their id is not known.
+  ///        They are counted on construction and move to the created count of their id once it is known.
+  std::uint64_t unidentified{ 0 };
+};
+
+#if ANYWHO_ENABLE_METRICS
+namespace detail {
+  /// @brief Counters of one thread. Only the owning thread writes, so plain relaxed stores are enough.
+  struct Shard
+  {
+    struct Slot
+    {
+      std::atomic<bool> used{ false };
+      std::atomic<ErrorId> id{ 0 };
+      std::atomic<std::uint64_t> created{ 0 };
+      std::atomic<std::uint64_t> propagated{ 0 };
+      std::atomic<std::uint64_t> contexts{ 0 };
+    };
+
+    std::atomic<bool> owned{ false };
+    std::array<Slot, ids_per_thread> slots{};
+    std::array<std::atomic<std::uint64_t>, depth_buckets> depths{};
+    std::atomic<std::uint64_t> dropped{ 0 };
+    // Both only grow, the difference of their sums over all shards is Snapshot::unidentified.
+    std::atomic<std::uint64_t> unidentified{ 0 };
+    std::atomic<std::uint64_t> identified{ 0 };
+  };
+
+  /// @brief Shards are preallocated, so counting never allocates and works in allocation free code paths
+  inline constinit std::array<Shard, max_threads> shards{};
+  /// @brief Used by threads that did not get a shard, shared and hence counted with read-modify-write
+  inline constinit std::atomic<std::uint64_t> dropped{ 0 };
+
+  inline void bump(std::atomic<std::uint64_t> &counter)
+  {
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  /// @brief Shard of the current thread, constant initialized so that reading it needs no initialization check
+  inline constinit thread_local Shard *current_shard{ nullptr };
+  /// @brief Set when the thread handed its shard back, events of later thread_local destructors are dropped
+  inline constinit thread_local bool shard_released{ false };
+
+  /// @brief Claims a shard for the lifetime of the thread and hands it to the next thread afterwards
+  class ShardOwner
+  {
+  public:
+    ShardOwner()
+    {
+      for (auto &el : shards) {
+        bool expected = false;
+        if (el.owned.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+          shard_ = &el;
+          return;
+        }
+      }
+    }
+    ShardOwner(const ShardOwner &) = delete;
+    ShardOwner(ShardOwner &&) = delete;
+    ShardOwner &operator=(const ShardOwner &) = delete;
+    ShardOwner &operator=(ShardOwner &&) = delete;
+    ~ShardOwner()
+    {
+      // Another thread may own the shard right after, so this thread must not write to it anymore.
+      current_shard = nullptr;
+      shard_released = true;
+      if (shard_ != nullptr) { shard_->owned.store(false, std::memory_order_release); }
+    }
+
+    [[nodiscard]] Shard *shard() const { return shard_; }
+
+  private:
+    Shard *shard_{ nullptr };
+  };
+
+  inline Shard *local_shard()
+  {
+    if (current_shard == nullptr) [[unlikely]] {
+      if (shard_released) { return nullptr; }
+      thread_local const ShardOwner owner;
+      current_shard = owner.shard();
+    }
+    return current_shard;
+  }
+
+  /// @brief Slot of id in the shard of the current thread, nullptr if the event can not be counted
+  inline Shard::Slot *local_slot(ErrorId id)
+  {
+    Shard *shard = local_shard();
+    if (shard == nullptr) { return nullptr; }
+
+    for (std::size_t probe = 0; probe < ids_per_thread; ++probe) {
+      auto &slot = shard->slots[(id + probe) % ids_per_thread];
+      if (!slot.used.load(std::memory_order_relaxed)) {
+        slot.id.store(id, std::memory_order_relaxed);
+        slot.used.store(true, std::memory_order_release);
+        return &slot;
+      }
+      if (slot.id.load(std::memory_order_relaxed) == id) { return &slot; }
+    }
+    return nullptr;
+  }
+
+  inline void count(ErrorId id, std::atomic<std::uint64_t> Shard::Slot::*counter)
+  {
+    if (auto *slot = local_slot(id)) {
+      bump((*slot).*counter);
+    } else if (Shard *shard = local_shard()) {
+      bump(shard->dropped);
+    } else {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+}// namespace detail
+
+/**
+ * @brief Per error bookkeeping of the counters, a member of every error base class. Every error is counted on
+ *        construction: errors with a static id under their id, others as unidentified, since the base class can not
+ *        call id() of the dynamic type yet. Those move to their id on their first context or propagation, errors
+ *        handled right where they were created stay unidentified. The propagation depth is recorded when the error
+ *        is destroyed, copies of an error are not counted again.
+ *
+ */
+class Probe final
+{
+public:
+  Probe() = default;
+  // A copy is the same error, so it is not counted again and does not record its depth.
+  Probe(const Probe &other) : id_{ other.id_ }, seen_{ other.seen_ }, depth_{ other.depth_ } {}
+  Probe(Probe &&other) noexcept
+    : id_{ other.id_ }, seen_{ other.seen_ }, recording_{ std::exchange(other.recording_, false) },
+      unidentified_{ std::exchange(other.unidentified_, false) }, depth_{ other.depth_ }
+  {}
+  Probe &operator=(const Probe &other)
+  {
+    if (this != &other) {
+      record_depth();
+      id_ = other.id_;
+      seen_ = other.seen_;
+      recording_ = false;
+      depth_ = other.depth_;
+    }
+    return *this;
+  }
+  Probe &operator=(Probe &&other) noexcept
+  {
+    if (this != &other) {
+      record_depth();
+      id_ = other.id_;
+      seen_ = other.seen_;
+      recording_ = std::exchange(other.recording_, false);
+      unidentified_ = std::exchange(other.unidentified_, false);
+      depth_ = other.depth_;
+    }
+    return *this;
+  }
+  ~Probe() { record_depth(); }
+
+  /// @brief Count an error whose id is not known yet, the first created() moves it to the id
+  void created_without_id()
+  {
+    if (detail::Shard *shard = detail::local_shard()) {
+      detail::bump(shard->unidentified);
+      unidentified_ = true;
+    } else {
+      detail::dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  void created(ErrorId id)
+  {
+    if (seen_) { return; }
+    if (std::exchange(unidentified_, false)) {
+      if (detail::Shard *shard = detail::local_shard()) { detail::bump(shard->identified); }
+    }
+    seen_ = true;
+    recording_ = true;
+    id_ = id;
+    detail::count(id_, &detail::Shard::Slot::created);
+  }
+
+  /// @brief Count a hop, id_of is only called if the error was not seen before
+  template<typename F> void propagated(F &&id_of)
+  {
+    if (!seen_) { created(id_of()); }
+    ++depth_;
+    detail::count(id_, &detail::Shard::Slot::propagated);
+  }
+
+  /// @brief Count a context, id_of is only called if the error was not seen before
+  template<typename F> void context(F &&id_of)
+  {
+    if (!seen_) { created(id_of()); }
+    detail::count(id_, &detail::Shard::Slot::contexts);
+  }
+
+private:
+  void record_depth() const
+  {
+    if (!recording_) { return; }
+    if (detail::Shard *shard = detail::local_shard()) {
+      detail::bump(shard->depths[std::min<std::size_t>(depth_, depth_buckets - 1)]);
+    }
+  }
+
+  // Cached, since id() of errors without a static id hashes their message on every call.
+  ErrorId id_{ 0 };
+  bool seen_{ false };
+  bool recording_{ false };
+  // Counted by created_without_id and not moved to an id yet. Copies leave it, so that only one of them moves it.
+  bool unidentified_{ false };
+  std::uint32_t depth_{ 0 };
+};
+
+/**
+ * @brief Sum the counters of all threads. Counters are read while other threads keep counting, so the result is a
+ *        consistent view of each counter but not of all of them at one point in time.
+ *
+ * @return Snapshot
+ */
+inline Snapshot snapshot()
+{
+  Snapshot out;
+  out.dropped = detail::dropped.load(std::memory_order_relaxed);
+  std::uint64_t identified{ 0 };
+  for (const auto &shard : detail::shards) {
+    out.dropped += shard.dropped.load(std::memory_order_relaxed);
+    out.unidentified += shard.unidentified.load(std::memory_order_relaxed);
+    identified += shard.identified.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i < depth_buckets; ++i) {
+      out.depth_histogram[i] += shard.depths[i].load(std::memory_order_relaxed);
+    }
+    for (const auto &slot : shard.slots) {
+      if (!slot.used.load(std::memory_order_acquire)) { continue; }
+      const ErrorId id = slot.id.load(std::memory_order_relaxed);
+      auto found = std::ranges::find(out.errors, id, &ErrorCount::id);
+      if (found == out.errors.end()) { found = out.errors.insert(out.errors.end(), ErrorCount{ id }); }
+      found->created += slot.created.load(std::memory_order_relaxed);
+      found->propagated += slot.propagated.load(std::memory_order_relaxed);
+      found->contexts += slot.contexts.load(std::memory_order_relaxed);
+    }
+  }
+  std::ranges::sort(out.errors, {}, &ErrorCount::id);
+  // An error can be identified on a shard that was read before the one that counted it.
+  out.unidentified -= std::min(identified, out.unidentified);
+
+  return out;
+}
+#else
+/// @brief Compiled out: empty and every call is a no-op
+class Probe final
+{
+public:
+  void created_without_id() {}
+  void created(ErrorId /*id*/) {}
+  template<typename F> void propagated(F && /*id_of*/) {}
+  template<typename F> void context(F && /*id_of*/) {}
+};
+
+/// @brief Compiled out: always empty
+inline Snapshot snapshot() { return {}; }
+#endif
+
+/// @brief True if the counters are compiled in
+inline constexpr bool enabled{ ANYWHO_ENABLE_METRICS != 0 };
+
+}// namespace anywho::metrics
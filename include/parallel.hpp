@@ -0,0 +1,537 @@
+#pragma once
+
+#include "error_list.hpp"
+#include "has_error.hpp"
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <expected>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <stop_token>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace anywho {
+
+/**
+ * @brief Threads that run the chunks of the parallel algorithms, together with the thread that calls them.
+ *        A pool runs one algorithm at a time. Algorithms that are started while it is busy, f.e. from within one
+ *        of its tasks, run on the calling thread alone instead of waiting.
+ *
+ */
+class WorkPool final
+{
+public:
+  /// @brief One thread less than the hardware has, the calling thread takes part as well
+  static std::size_t default_threads()
+  {
+    const std::size_t hardware = std::thread::hardware_concurrency();
+    return hardware > 1 ? hardware - 1 : 0;
+  }
+
+  explicit WorkPool(std::size_t threads = default_threads())
+  {
+    workers_.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i) {
+      workers_.emplace_back([this, participant = i + 1] { work(participant); });
+    }
+  }
+  WorkPool(const WorkPool &) = delete;
+  WorkPool(WorkPool &&) = delete;
+  WorkPool &operator=(const WorkPool &) = delete;
+  WorkPool &operator=(WorkPool &&) = delete;
+  ~WorkPool()
+  {
+    stopping_.store(true, std::memory_order_relaxed);
+    generation_.fetch_add(1, std::memory_order_release);
+    generation_.notify_all();
+  }
+
+  /// @brief Number of threads that run a job, including the calling one
+  [[nodiscard]] std::size_t concurrency() const { return workers_.size() + 1; }
+
+  /**
+   * @brief Call job(participant) on every thread of the pool and on the calling thread as participant 0, and wait
+   *        until all calls returned. job must not throw.
+   *
+   * @tparam Job Callable with the index of the participant
+   * @param job Job to run
+   */
+  template<typename Job> void run(Job &job)
+  {
+    if (workers_.empty() || busy_.test_and_set(std::memory_order_acquire)) {
+      job(std::size_t{ 0 });
+      return;
+    }
+
+    job_ = &job;
+    call_ = [](void *ptr, std::size_t participant) { (*static_cast<Job *>(ptr))(participant); };
+    pending_.store(workers_.size(), std::memory_order_relaxed);
+    generation_.fetch_add(1, std::memory_order_release);
+    generation_.notify_all();
+
+    job(std::size_t{ 0 });
+    for (auto left = pending_.load(std::memory_order_acquire); left != 0;
+         left = pending_.load(std::memory_order_acquire)) {
+      pending_.wait(left, std::memory_order_acquire);
+    }
+    busy_.clear(std::memory_order_release);
+  }
+
+private:
+  void work(std::size_t participant)
+  {
+    std::uint64_t seen = 0;
+    while (true) {
+      generation_.wait(seen, std::memory_order_acquire);
+      seen = generation_.load(std::memory_order_acquire);
+      if (stopping_.load(std::memory_order_relaxed)) { return; }
+
+      call_(job_, participant);
+      if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) { pending_.notify_one(); }
+    }
+  }
+
+  void *job_{ nullptr };
+  void (*call_)(void *, std::size_t){ nullptr };
+  std::atomic<std::uint64_t> generation_{ 0 };
+  std::atomic<std::size_t> pending_{ 0 };
+  std::atomic<bool> stopping_{ false };
+  std::atomic_flag busy_{};
+  // Last, so that the threads are joined before anything they use is destroyed
+  std::vector<std::jthread> workers_{};
+};
+
+/// @brief Pool of the parallel algorithms unless a policy names another, started on first use
+inline WorkPool &default_work_pool()
+{
+  static WorkPool pool;
+  return pool;
+}
+
+namespace execution {
+  /// @brief Run on the calling thread, in order
+  struct Sequential
+  {
+  };
+
+  /// @brief Split the range into chunks that the threads of a WorkPool take from each other
+  struct Parallel
+  {
+    /// @brief nullptr for default_work_pool()
+    WorkPool *pool{ nullptr };
+    /// @brief Elements per chunk, 0 for about eight chunks per thread
+    std::size_t chunk_size{ 0 };
+  };
+
+  inline constexpr Sequential seq{};
+  inline constexpr Parallel par{};
+}// namespace execution
+
+namespace detail {
+  template<typename P>
+  concept ExecutionPolicy = std::same_as<P, execution::Sequential> || std::same_as<P, execution::Parallel>;
+
+  /// @brief Call f with the element, and with the stop token if f takes one
+  template<typename F, typename Ref> decltype(auto) invoke_step(F &f, Ref &&ref, const std::stop_token &stop)
+  {
+    if constexpr (std::invocable<F &, Ref, std::stop_token>) {
+      return std::invoke(f, std::forward<Ref>(ref), stop);
+    } else {
+      return std::invoke(f, std::forward<Ref>(ref));
+    }
+  }
+
+  template<typename F, typename R>
+  using step_result_t = std::remove_cvref_t<decltype(invoke_step(
+    std::declval<F &>(), std::declval<std::ranges::range_reference_t<R>>(), std::declval<const std::stop_token &>()))>;
+
+  template<typename Result> struct StepTraits;
+  template<typename T, typename E> struct StepTraits<std::expected<T, E>>
+  {
+    using value_type = T;
+    using error_type = E;
+    static E &&error(std::expected<T, E> &result) { return std::move(result).error(); }
+  };
+  template<typename E> struct StepTraits<std::optional<E>>
+  {
+    using value_type = void;
+    using error_type = E;
+    static E &&error(std::optional<E> &result) { return std::move(*result); }
+  };
+
+  inline constexpr std::size_t no_index{ std::numeric_limits<std::size_t>::max() };
+
+  /**
+   * @brief Chunks of each participant, packed as next and end into one word. The owner takes chunks from the
+   *        front, others steal from the back once they ran out of their own.
+   *
+   */
+  class ChunkQueues final
+  {
+  public:
+    ChunkQueues(std::size_t chunks, std::size_t participants)
+      : queues_{ std::make_unique<Queue[]>(participants) }, count_{ participants }
+    {
+      for (std::size_t i = 0; i < participants; ++i) {
+        queues_[i].range.store(pack(chunks * i / participants, chunks * (i + 1) / participants),
+          std::memory_order_relaxed);
+      }
+    }
+
+    /// @brief Next chunk for participant self, no_index once all chunks are taken
+    std::size_t pop(std::size_t self)
+    {
+      if (const auto own = take(queues_[self], true); own != no_index) { return own; }
+      for (std::size_t i = 1; i < count_; ++i) {
+        if (const auto stolen = take(queues_[(self + i) % count_], false); stolen != no_index) { return stolen; }
+      }
+      return no_index;
+    }
+
+  private:
+    struct alignas(64) Queue
+    {
+      std::atomic<std::uint64_t> range{ 0 };
+    };
+
+    static constexpr std::uint64_t pack(std::size_t next, std::size_t end)
+    {
+      return std::uint64_t{ next } << 32U | std::uint64_t{ end };
+    }
+
+    static std::size_t take(Queue &queue, bool front)
+    {
+      std::uint64_t range = queue.range.load(std::memory_order_relaxed);
+      while (true) {
+        const std::size_t next = range >> 32U;
+        const std::size_t end = range & 0xffffffffU;
+        if (next >= end) { return no_index; }
+        const std::uint64_t taken = front ? pack(next + 1, end) : pack(next, end - 1);
+        if (queue.range.compare_exchange_weak(range, taken, std::memory_order_relaxed)) {
+          return front ? next : end - 1;
+        }
+      }
+    }
+
+    std::unique_ptr<Queue[]> queues_;
+    std::size_t count_;
+  };
+
+  /**
+   * @brief Shared state of one call of a parallel algorithm. Runs body(participant, begin, end, stop) for every
+   *        chunk and keeps track of the lowest failing index: chunks behind it are not started anymore and chunks
+   *        behind it that are running get their stop token triggered. Chunks before it always run to the end, so
+   *        the error that is kept does not depend on the scheduling.
+   *
+   */
+  class ParallelRun final
+  {
+  public:
+    ParallelRun(const execution::Sequential & /*policy*/, std::size_t size, bool stoppable)
+      : ParallelRun(nullptr, size, size, 1, stoppable)
+    {}
+
+    ParallelRun(const execution::Parallel &policy, std::size_t size, bool stoppable)
+      : ParallelRun(policy.pool != nullptr ? policy.pool : &default_work_pool(),
+          size,
+          policy.chunk_size,
+          (policy.pool != nullptr ? policy.pool : &default_work_pool())->concurrency(),
+          stoppable)
+    {}
+
+    [[nodiscard]] std::size_t participants() const { return participants_; }
+    [[nodiscard]] std::size_t chunks() const { return chunks_; }
+    [[nodiscard]] std::size_t chunk_of(std::size_t index) const { return index / chunk_size_; }
+
+    /// @brief True if the element does not need to run anymore
+    [[nodiscard]] bool cancelled(std::size_t index) const
+    {
+      return index > first_error_.load(std::memory_order_relaxed) || aborted_.load(std::memory_order_relaxed);
+    }
+
+    /// @brief The element failed, cancel everything behind it
+    void fail(std::size_t index)
+    {
+      std::size_t first = first_error_.load(std::memory_order_relaxed);
+      while (index < first && !first_error_.compare_exchange_weak(first, index)) {}
+      stop_running([this, index](std::size_t chunk) { return chunk * chunk_size_ > index; });
+    }
+
+    template<typename Body> void execute(Body &body)
+    {
+      auto job = [this, &body](std::size_t participant) { work(participant, body); };
+      if (pool_ == nullptr) {
+        job(std::size_t{ 0 });
+      } else {
+        pool_->run(job);
+      }
+      if (exception_ != nullptr) { std::rethrow_exception(exception_); }
+    }
+
+  private:
+    struct alignas(64) Current
+    {
+      std::atomic<std::size_t> chunk{ no_index };
+    };
+
+    ParallelRun(WorkPool *pool, std::size_t size, std::size_t chunk_size, std::size_t participants, bool stoppable)
+      : pool_{ pool }, participants_{ participants },
+        chunk_size_{ std::max({ chunk_size != 0 ? chunk_size : size / (participants * 8),
+          std::size_t{ 1 },
+          size / std::numeric_limits<std::uint32_t>::max() + 1 }) },
+        chunks_{ (size + chunk_size_ - 1) / chunk_size_ }, size_{ size }, queues_{ chunks_, participants },
+        current_{ std::make_unique<Current[]>(participants) }
+    {
+      if (stoppable) { sources_.resize(chunks_); }
+    }
+
+    template<typename Body> void work(std::size_t participant, Body &body)
+    {
+      try {
+        for (auto chunk = queues_.pop(participant); chunk != no_index; chunk = queues_.pop(participant)) {
+          // Published before checking for cancellation, fail() sees either this or this sees its index.
+          current_[participant].chunk.store(chunk);
+          const std::size_t begin = chunk * chunk_size_;
+          if (begin > first_error_.load() || aborted_.load()) { continue; }
+
+          const std::stop_token stop = sources_.empty() ? std::stop_token{} : sources_[chunk].get_token();
+          body(participant, begin, std::min(begin + chunk_size_, size_), stop);
+        }
+      } catch (...) {
+        {
+          const std::scoped_lock lock{ mutex_ };
+          if (exception_ == nullptr) { exception_ = std::current_exception(); }
+        }
+        aborted_.store(true);
+        stop_running([](std::size_t /*chunk*/) { return true; });
+      }
+      current_[participant].chunk.store(no_index);
+    }
+
+    template<typename Predicate> void stop_running(Predicate predicate)
+    {
+      if (sources_.empty()) { return; }
+      for (std::size_t i = 0; i < participants_; ++i) {
+        const std::size_t chunk = current_[i].chunk.load();
+        if (chunk != no_index && predicate(chunk)) { sources_[chunk].request_stop(); }
+      }
+    }
+
+    WorkPool *pool_;
+    std::size_t participants_;
+    std::size_t chunk_size_;
+    std::size_t chunks_;
+    std::size_t size_;
+    ChunkQueues queues_;
+    std::unique_ptr<Current[]> current_;
+    std::vector<std::stop_source> sources_{};
+    std::atomic<std::size_t> first_error_{ no_index };
+    std::atomic<bool> aborted_{ false };
+    std::mutex mutex_{};
+    std::exception_ptr exception_{};
+  };
+
+  /// @brief Lowest failing index and its error, one per participant so that they do not share anything
+  template<typename E> struct alignas(64) FirstError
+  {
+    std::size_t index{ no_index };
+    std::optional<E> error{};
+  };
+
+  template<typename E> std::optional<E> lowest_error(std::vector<FirstError<E>> &errors)
+  {
+    const auto lowest = std::ranges::min_element(errors, {}, &FirstError<E>::index);
+    if (lowest == errors.end() || lowest->index == no_index) { return std::nullopt; }
+    return std::move(lowest->error);
+  }
+
+  template<typename F, typename R>
+  inline constexpr bool takes_stop_token_v = std::invocable<F &, std::ranges::range_reference_t<R>, std::stop_token>;
+
+  /**
+   * @brief Run f over the range, handing values of successful steps to on_value(index, value) and failures to
+   *        on_error(participant, chunk, index, error). With cancel the first failure cancels what is behind it.
+   *
+   */
+  template<typename R, typename F, typename OnValue, typename OnError>
+  void run_steps(ParallelRun &run, R &range, F &f, bool cancel, OnValue on_value, OnError on_error)
+  {
+    using Result = step_result_t<F, R>;
+    using Traits = StepTraits<Result>;
+
+    auto body = [&](std::size_t participant, std::size_t begin, std::size_t end, const std::stop_token &stop) {
+      auto it = std::ranges::begin(range) + static_cast<std::ranges::range_difference_t<R>>(begin);
+      for (std::size_t i = begin; i < end; ++i, ++it) {
+        if (run.cancelled(i)) { return; }
+        Result result = invoke_step(f, *it, stop);
+        if (has_error(result)) {
+          on_error(participant, run.chunk_of(i), i, Traits::error(result));
+          if (cancel) {
+            run.fail(i);
+            return;
+          }
+        } else if constexpr (!std::is_void_v<typename Traits::value_type>) {
+          on_value(i, std::move(*result));
+        }
+      }
+    };
+    run.execute(body);
+  }
+
+  template<typename Policy, typename R, typename F>
+  concept StepRange = ExecutionPolicy<Policy> && std::ranges::random_access_range<R> && std::ranges::sized_range<R>
+                      && requires { typename StepTraits<step_result_t<F, R>>::error_type; };
+
+  template<typename F, typename R> using step_value_t = typename StepTraits<step_result_t<F, R>>::value_type;
+  template<typename F, typename R> using step_error_t = typename StepTraits<step_result_t<F, R>>::error_type;
+
+  /// @brief Keeps the error with the lowest index of each participant
+  template<typename E> auto keep_first(std::vector<FirstError<E>> &errors)
+  {
+    return [&errors](std::size_t participant, std::size_t /*chunk*/, std::size_t index, E &&error) {
+      auto &first = errors[participant];
+      if (index < first.index) {
+        first.index = index;
+        first.error.emplace(std::move(error));
+      }
+    };
+  }
+
+  /// @brief Collects all errors, one list per chunk so that they end up in the order of the range
+  template<typename E> auto keep_all(std::vector<ErrorList> &lists)
+  {
+    return [&lists](std::size_t /*participant*/, std::size_t chunk, std::size_t /*index*/, E &&error) {
+      lists[chunk].push(error);
+    };
+  }
+
+  inline ErrorList merge_lists(std::vector<ErrorList> &lists)
+  {
+    ErrorList all;
+    for (auto &list : lists) { all.merge(std::move(list)); }
+    return all;
+  }
+}// namespace detail
+
+/**
+ * @brief Apply f to every element of the range and collect the values, stopping at the first error.
+ *        Use like
+ *        auto parsed = anywho::try_transform(anywho::execution::par, lines, parseLine);
+ *        f returns std::expected<T, E> and is called from several threads at once with execution::par. If it also
+ *        takes a std::stop_token, the token is triggered once an element before it failed and its result is not
+ *        needed anymore.
+ *        Elements before a failing one always run, so the error is the one of the lowest failing index, no matter
+ *        how the work was scheduled. Elements behind it may or may not have run.
+ *
+ * @param policy execution::seq or execution::par
+ * @param range Random access range with a known size
+ * @param f Step, called with the elements
+ * @return std::expected<std::vector<T>, E> All values in the order of the range, or the first error
+ */
+template<typename Policy, typename R, typename F>
+  requires detail::StepRange<Policy, R, F> && detail::IsExpected<detail::step_result_t<F, R>>::value
+auto try_transform(const Policy &policy, R &&range, F f)
+  -> std::expected<std::vector<detail::step_value_t<F, R>>, detail::step_error_t<F, R>>
+{
+  using T = detail::step_value_t<F, R>;
+  using E = detail::step_error_t<F, R>;
+  static_assert(std::default_initializable<T> && !std::same_as<T, bool>,
+    "values are assigned into a std::vector of the size of the range from several threads");
+
+  detail::ParallelRun run{ policy, std::ranges::size(range), detail::takes_stop_token_v<F, R> };
+  std::vector<T> out(std::ranges::size(range));
+  std::vector<detail::FirstError<E>> errors(run.participants());
+  detail::run_steps(
+    run, range, f, true, [&out](std::size_t index, T &&value) { out[index] = std::move(value); },
+    detail::keep_first(errors));
+
+  if (auto error = detail::lowest_error(errors)) { return std::unexpected(std::move(*error)); }
+  return out;
+}
+
+/**
+ * @brief Like try_transform, but runs all elements and returns every error in the order of the range.
+ *
+ * @param policy execution::seq or execution::par
+ * @param range Random access range with a known size
+ * @param f Step, called with the elements
+ * @return std::expected<std::vector<T>, ErrorList> All values, or all errors
+ */
+template<typename Policy, typename R, typename F>
+  requires detail::StepRange<Policy, R, F> && detail::IsExpected<detail::step_result_t<F, R>>::value
+           && concepts::Error<detail::step_error_t<F, R>>
+auto try_transform_all(const Policy &policy, R &&range, F f)
+  -> std::expected<std::vector<detail::step_value_t<F, R>>, ErrorList>
+{
+  using T = detail::step_value_t<F, R>;
+  static_assert(std::default_initializable<T> && !std::same_as<T, bool>,
+    "values are assigned into a std::vector of the size of the range from several threads");
+
+  detail::ParallelRun run{ policy, std::ranges::size(range), false };
+  std::vector<T> out(std::ranges::size(range));
+  std::vector<ErrorList> lists(run.chunks());
+  detail::run_steps(
+    run, range, f, false, [&out](std::size_t index, T &&value) { out[index] = std::move(value); },
+    detail::keep_all<detail::step_error_t<F, R>>(lists));
+
+  if (ErrorList errors = detail::merge_lists(lists); !errors.empty()) { return std::unexpected(std::move(errors)); }
+  return out;
+}
+
+/**
+ * @brief Call f for every element of the range, stopping at the first error like try_transform does.
+ *        f returns std::expected<void, E> (or any other std::expected) or an ErrorState<E>.
+ *
+ * @param policy execution::seq or execution::par
+ * @param range Random access range with a known size
+ * @param f Step, called with the elements
+ * @return std::expected<void, E> The error of the lowest failing index, if any
+ */
+template<typename Policy, typename R, typename F>
+  requires detail::StepRange<Policy, R, F>
+auto try_for_each(const Policy &policy, R &&range, F f) -> std::expected<void, detail::step_error_t<F, R>>
+{
+  using E = detail::step_error_t<F, R>;
+
+  detail::ParallelRun run{ policy, std::ranges::size(range), detail::takes_stop_token_v<F, R> };
+  std::vector<detail::FirstError<E>> errors(run.participants());
+  detail::run_steps(run, range, f, true, [](std::size_t /*index*/, auto && /*value*/) {}, detail::keep_first(errors));
+
+  if (auto error = detail::lowest_error(errors)) { return std::unexpected(std::move(*error)); }
+  return {};
+}
+
+/**
+ * @brief Like try_for_each, but runs all elements and returns every error in the order of the range.
+ *
+ * @param policy execution::seq or execution::par
+ * @param range Random access range with a known size
+ * @param f Step, called with the elements
+ * @return std::expected<void, ErrorList> All errors, if any
+ */
+template<typename Policy, typename R, typename F>
+  requires detail::StepRange<Policy, R, F> && concepts::Error<detail::step_error_t<F, R>>
+auto try_for_each_all(const Policy &policy, R &&range, F f) -> std::expected<void, ErrorList>
+{
+  detail::ParallelRun run{ policy, std::ranges::size(range), false };
+  std::vector<ErrorList> lists(run.chunks());
+  detail::run_steps(run, range, f, false, [](std::size_t /*index*/, auto && /*value*/) {},
+    detail::keep_all<detail::step_error_t<F, R>>(lists));
+
+  if (ErrorList errors = detail::merge_lists(lists); !errors.empty()) { return std::unexpected(std::move(errors)); }
+  return {};
+}
+
+}// namespace anywho
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <type_traits>
+#include <utility>
+
+namespace anywho::detail {
+/**
+ * @brief True if E declares no context_policy, or the one its constructor applies. WithStaticId<E> names E its
+ *        policy_owner and passes it down, a type that derives from GenericError directly does not.
+ */
+template<typename E>
+concept applies_context_policy = !requires { E::context_policy; } || requires {
+  typename E::policy_owner;
+  requires &E::context_policy == &E::policy_owner::context_policy;
+};
+
+/// @brief Like applies_context_policy for stack_policy
+template<typename E>
+concept applies_stack_policy = !requires { E::stack_policy; } || requires {
+  typename E::policy_owner;
+  requires &E::stack_policy == &E::policy_owner::stack_policy;
+};
+
+/// @brief Rejects error types whose policies would be silently ignored, checked on every hook below
+template<typename E> constexpr void check_policies()
+{
+  static_assert(applies_context_policy<E> && applies_stack_policy<E>,
+    "context_policy and stack_policy are applied by WithStaticId, derive the error from WithStaticId<E> instead");
+}
+
+/**
+ * @brief Called by ANYWHO, ANYWHO_OPT, ANYWHO_LEGACY and co_await for every error they hand on. Errors that
+ *        provide on_propagation() add pending breadcrumbs there and count the hop if metrics are enabled.
+ *
+ * @tparam E Type of the error
+ * @param error Error that is propagated
+ * @return E&& The error, forwarded
+ */
+template<typename E> E &&on_propagation(E &&error)
+{
+  if constexpr (requires { error.on_propagation(); }) {
+    check_policies<std::remove_cvref_t<E>>();
+    error.on_propagation();
+  }
+
+  return std::forward<E>(error);
+}
+
+/**
+ * @brief Called by with_context after adding the context. Adds pending breadcrumbs like on_propagation, but does not
+ *        count a hop, the ANYWHO or co_await that hands the error on does.
+ *
+ * @tparam E Type of the error
+ * @param error Error that got a context
+ * @return E&& The error, forwarded
+ */
+template<typename E> E &&on_context(E &&error)
+{
+  if constexpr (requires { error.capture_breadcrumbs(); }) {
+    check_policies<std::remove_cvref_t<E>>();
+    error.capture_breadcrumbs();
+  }
+
+  return std::forward<E>(error);
+}
+}// namespace anywho::detail
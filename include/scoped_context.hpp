@@ -0,0 +1,138 @@
+#pragma once
+
+#include "context.hpp"
+#include <cstdint>
+#include <source_location>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace anywho {
+
+namespace detail {
+  class Breadcrumb;
+
+  /// @brief Innermost ScopedContext of the current thread, the guards form an intrusive stack through their parents
+  inline constinit thread_local const Breadcrumb *active_breadcrumb{ nullptr };
+  /// @brief Number of ScopedContext guards created on the current thread, gives every breadcrumb a unique serial
+  inline constinit thread_local std::uint64_t breadcrumb_count{ 0 };
+
+  /**
+   * @brief Node of the per thread stack of ScopedContext guards. Pushes itself on construction and pops itself on
+   *        destruction, nothing else is done until an error wants the breadcrumb as Context.
+   *
+   */
+  class Breadcrumb
+  {
+  public:
+    using ContextMaker = Context (*)(const Breadcrumb &);
+
+    Breadcrumb(const Breadcrumb &) = delete;
+    Breadcrumb(Breadcrumb &&) = delete;
+    Breadcrumb &operator=(const Breadcrumb &) = delete;
+    Breadcrumb &operator=(Breadcrumb &&) = delete;
+
+    [[nodiscard]] Context to_context() const { return make_context_(*this); }
+    [[nodiscard]] const Breadcrumb *parent() const { return parent_; }
+    /// @brief Serials grow from the bottom to the top of the stack
+    [[nodiscard]] std::uint64_t serial() const { return serial_; }
+    [[nodiscard]] const std::source_location &location() const { return location_; }
+
+  protected:
+    Breadcrumb(ContextMaker make_context, const std::source_location &location)
+      : parent_{ active_breadcrumb }, serial_{ ++breadcrumb_count }, make_context_{ make_context },
+        location_{ location }
+    {
+      active_breadcrumb = this;
+    }
+
+    ~Breadcrumb() { active_breadcrumb = parent_; }
+
+  private:
+    const Breadcrumb *parent_;
+    std::uint64_t serial_;
+    ContextMaker make_context_;
+    std::source_location location_;
+  };
+}// namespace detail
+
+/**
+ * @brief Remembers which breadcrumbs of ScopedContext guards were already added to an error, so that each of them is
+ *        added only once, no matter how often the error is propagated inside the scope.
+ *
+ */
+class BreadcrumbMark final
+{
+public:
+  /**
+   * @brief Hand the breadcrumbs of the current thread that were not added yet to add, innermost first.
+   *
+   * @tparam F Callable taking Context &&
+   * @param add Adds a breadcrumb as context to the error
+   */
+  template<typename F> void capture(F &&add)
+  {
+    const detail::Breadcrumb *top = detail::active_breadcrumb;
+    if (top == nullptr) { return; }
+
+    // Serials are only ordered within one thread, an error coming from another thread starts over.
+    if (thread_ != &detail::breadcrumb_count) {
+      thread_ = &detail::breadcrumb_count;
+      serial_ = 0;
+    }
+    if (top->serial() <= serial_) { return; }
+
+    for (const auto *el = top; el != nullptr && el->serial() > serial_; el = el->parent()) {
+      add(el->to_context());
+    }
+    serial_ = top->serial();
+  }
+
+private:
+  const void *thread_{ nullptr };
+  std::uint64_t serial_{ 0 };
+};
+
+/**
+ * @brief Context that is only attached if an error happens while it is alive. The guard pushes itself on a thread
+ *        local stack, errors that are created or propagated by ANYWHO or with_context inside the scope take over the
+ *        active guards as contexts. The message is only formatted then, so the happy path costs a push and a pop.
+ *        Use like
+ *        anywho::ScopedContext guard{ "processing order {}", order.id };
+ *        Lvalue arguments are referenced and must outlive the guard, rvalues are stored in the guard.
+ *        Guards must be destroyed on the thread that created them, so do not keep them alive across co_await.
+ *
+ * @tparam Args Types of the format arguments
+ */
+template<typename... Args> class ScopedContext final : detail::Breadcrumb
+{
+public:
+  explicit ScopedContext(detail::FormatWithLocation<std::type_identity_t<Args>...> fmt, Args &&...args)
+    : Breadcrumb{ &ScopedContext::make_context, fmt.location }, format_{ fmt.text },
+      args_{ std::forward<Args>(args)... }
+  {}
+
+  ScopedContext(const ScopedContext &) = delete;
+  ScopedContext(ScopedContext &&) = delete;
+  ScopedContext &operator=(const ScopedContext &) = delete;
+  ScopedContext &operator=(ScopedContext &&) = delete;
+  ~ScopedContext() = default;
+
+private:
+  static Context make_context(const Breadcrumb &crumb)
+  {
+    const auto &self = static_cast<const ScopedContext &>(crumb);
+    return std::apply(
+      [&self](const auto &...args) { return detail::make_formatted_context(self.format_, self.location(), args...); },
+      self.args_);
+  }
+
+  std::string_view format_;
+  std::tuple<Args...> args_;
+};
+
+template<typename... Args>
+ScopedContext(detail::FormatWithLocation<std::type_identity_t<Args>...>, Args &&...) -> ScopedContext<Args...>;
+
+}// namespace anywho
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace anywho {
+
+/**
+ * @brief Vector that keeps the first N elements inside the object and only spills to the heap when it grows beyond.
+ *        Only what is needed to store context chains is implemented.
+ *
+ * @tparam T Type of the elements
+ * @tparam N Number of elements that are stored inline, must be at least one
+ */
+template<typename T, std::size_t N> class SmallVector final
+{
+  static_assert(N > 0, "use std::vector if no inline storage is needed");
+
+public:
+  using value_type = T;
+  using iterator = T *;
+  using const_iterator = const T *;
+
+  SmallVector() = default;
+
+  SmallVector(const SmallVector &other)
+  {
+    reserve(other.size_);
+    std::uninitialized_copy(other.begin(), other.end(), data_);
+    size_ = other.size_;
+  }
+
+  SmallVector(SmallVector &&other) noexcept { steal(std::move(other)); }
+
+  SmallVector &operator=(const SmallVector &other)
+  {
+    if (this != &other) { *this = SmallVector{ other }; }
+    return *this;
+  }
+
+  SmallVector &operator=(SmallVector &&other) noexcept
+  {
+    if (this != &other) {
+      reset();
+      steal(std::move(other));
+    }
+    return *this;
+  }
+
+  ~SmallVector() { reset(); }
+
+  template<typename... Args> T &emplace_back(Args &&...args)
+  {
+    if (size_ == capacity_) { reserve(capacity_ * 2); }
+    T *element = std::construct_at(data_ + size_, std::forward<Args>(args)...);
+    ++size_;
+    return *element;
+  }
+
+  void push_back(T &&value) { emplace_back(std::move(value)); }
+  void push_back(const T &value) { emplace_back(value); }
+
+  void reserve(std::size_t capacity)
+  {
+    if (capacity <= capacity_) { return; }
+    T *buffer = std::allocator<T>{}.allocate(capacity);
+    std::uninitialized_move(begin(), end(), buffer);
+    std::destroy(begin(), end());
+    deallocate();
+    data_ = buffer;
+    capacity_ = capacity;
+  }
+
+  void clear()
+  {
+    std::destroy(begin(), end());
+    size_ = 0;
+  }
+
+  [[nodiscard]] std::size_t size() const { return size_; }
+  [[nodiscard]] std::size_t capacity() const { return capacity_; }
+  [[nodiscard]] bool empty() const { return size_ == 0; }
+  /// @brief True as long as no element was spilled to the heap
+  [[nodiscard]] bool is_inline() const { return data_ == inline_data(); }
+
+  T &operator[](std::size_t index) { return data_[index]; }
+  const T &operator[](std::size_t index) const { return data_[index]; }
+
+  iterator begin() { return data_; }
+  iterator end() { return data_ + size_; }
+  const_iterator begin() const { return data_; }
+  const_iterator end() const { return data_ + size_; }
+
+private:
+  T *inline_data() { return reinterpret_cast<T *>(inline_); }
+  const T *inline_data() const { return reinterpret_cast<const T *>(inline_); }
+
+  void deallocate()
+  {
+    if (!is_inline()) { std::allocator<T>{}.deallocate(data_, capacity_); }
+  }
+
+  void reset()
+  {
+    clear();
+    deallocate();
+    data_ = inline_data();
+    capacity_ = N;
+  }
+
+  /// @brief Take over the heap buffer of other, or move its inline elements. Expects this to be empty and inline.
+  void steal(SmallVector &&other)
+  {
+    if (other.is_inline()) {
+      std::uninitialized_move(other.begin(), other.end(), data_);
+      size_ = other.size_;
+      other.clear();
+    } else {
+      data_ = std::exchange(other.data_, other.inline_data());
+      size_ = std::exchange(other.size_, 0);
+      capacity_ = std::exchange(other.capacity_, N);
+    }
+  }
+
+  alignas(T) std::byte inline_[N * sizeof(T)];
+  T *data_{ inline_data() };
+  std::size_t size_{ 0 };
+  std::size_t capacity_{ N };
+};
+
+}// namespace anywho
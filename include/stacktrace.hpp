@@ -0,0 +1,217 @@
+#pragma once
+
+#include "format.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <string>
+#include <string_view>
+
+/**
+ * Capturing stack traces is opt-in. Define ANYWHO_ENABLE_STACKTRACE to 1 for the whole program (the CMake option
+ * anywho_ENABLE_STACKTRACE does so), otherwise StackTrace is empty and errors capture nothing.
+ */
+#ifndef ANYWHO_ENABLE_STACKTRACE
+#define ANYWHO_ENABLE_STACKTRACE 0
+#endif
+
+#if ANYWHO_ENABLE_STACKTRACE
+#if !__has_include(<unwind.h>) || !__has_include(<dlfcn.h>)
+#error "ANYWHO_ENABLE_STACKTRACE needs <unwind.h> and <dlfcn.h>"
+#endif
+#include <cstdlib>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unwind.h>
+#endif
+
+namespace anywho {
+
+/**
+ * @brief Which errors of a type capture a stack trace. Declare it in an error type to override the default always,
+ *        f.e. for errors that are created often and handled right away:
+ *        static constexpr anywho::StackPolicy stack_policy{ anywho::StackPolicy::sampled(100) };
+ *
+ */
+class StackPolicy final
+{
+public:
+  static constexpr StackPolicy never() { return StackPolicy{ 0 }; }
+  static constexpr StackPolicy always() { return StackPolicy{ 1 }; }
+  /// @brief Every n-th error of the type per thread
+  static constexpr StackPolicy sampled(std::uint32_t every) { return StackPolicy{ every }; }
+
+  [[nodiscard]] constexpr std::uint32_t every() const { return every_; }
+
+private:
+  constexpr explicit StackPolicy(std::uint32_t every) : every_{ every } {}
+
+  std::uint32_t every_;
+};
+
+#if ANYWHO_ENABLE_STACKTRACE
+namespace detail {
+  /**
+   * @brief Symbol of a return address, resolved once per address for the whole process.
+   *
+   * @param address Return address
+   * @return std::string_view Demangled symbol and offset, valid until the end of the program
+   */
+  inline std::string_view symbolize(const void *address)
+  {
+    static std::mutex mutex;
+    static std::unordered_map<const void *, std::string> cache;
+
+    const std::scoped_lock lock{ mutex };
+    auto [found, inserted] = cache.try_emplace(address);
+    if (!inserted) { return found->second; }
+
+    Dl_info info{};
+    if (dladdr(address, &info) == 0) {
+      found->second = format_ns::format("{}", address);
+    } else if (info.dli_sname == nullptr) {
+      const std::string_view file = info.dli_fname != nullptr ? info.dli_fname : "";
+      found->second = format_ns::format("{}+{:#x}",
+        file.substr(file.find_last_of('/') + 1),
+        static_cast<const char *>(address) - static_cast<const char *>(info.dli_fbase));
+    } else {
+      int status = 0;
+      const std::unique_ptr<char, decltype(&std::free)> demangled{
+        abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status), &std::free
+      };
+      found->second = format_ns::format("{}+{:#x}",
+        demangled != nullptr ? demangled.get() : info.dli_sname,
+        static_cast<const char *>(address) - static_cast<const char *>(info.dli_saddr));
+    }
+    return found->second;
+  }
+}// namespace detail
+
+/**
+ * @brief Raw return addresses of the stack an error was created on. Capturing only walks the stack into a fixed
+ *        inline array, symbols are resolved when the trace is formatted. Functions are only named if their symbols
+ *        are exported, so link executables with -rdynamic.
+ *
+ */
+class StackTrace final
+{
+public:
+  static constexpr std::size_t max_frames{ 16 };
+
+  /**
+   * @brief Record the stack of the caller, replacing what was recorded before.
+   *
+   * @param skip Frames below the caller to leave out
+   */
+  [[gnu::noinline]] void capture(std::size_t skip = 0)
+  {
+    struct Walk
+    {
+      StackTrace *trace;
+      std::size_t skip;
+    } walk{ this, skip + 1 };// + 1 for capture itself
+
+    size_ = 0;
+    _Unwind_Backtrace(
+      [](_Unwind_Context *context, void *arg) -> _Unwind_Reason_Code {
+        auto &state = *static_cast<Walk *>(arg);
+        const auto ip = _Unwind_GetIP(context);
+        if (ip == 0) { return _URC_END_OF_STACK; }
+        if (state.skip > 0) {
+          --state.skip;
+          return _URC_NO_REASON;
+        }
+        state.trace->frames_[state.trace->size_++] = reinterpret_cast<const void *>(ip);
+        return state.trace->size_ == max_frames ? _URC_END_OF_STACK : _URC_NO_REASON;
+      },
+      &walk);
+  }
+
+  [[nodiscard]] std::span<const void *const> frames() const { return { frames_.data(), size_ }; }
+  [[nodiscard]] bool empty() const { return size_ == 0; }
+
+  [[nodiscard]] std::string format() const
+  {
+    std::string out;
+    format_to(std::back_inserter(out));
+
+    return out;
+  }
+
+  /**
+   * @brief Write one line per frame, innermost first, resolving symbols on the way.
+   *
+   * @tparam OutputIt Output iterator of char
+   * @param out Where to write to
+   * @return OutputIt Iterator past the last written char
+   */
+  template<typename OutputIt> OutputIt format_to(OutputIt out) const
+  {
+    for (std::size_t i = 0; i < size_; ++i) {
+      out = format_ns::format_to(out, "#{} {}\n", i, detail::symbolize(frames_[i]));
+    }
+    return out;
+  }
+
+private:
+  std::array<const void *, max_frames> frames_{};
+  std::size_t size_{ 0 };
+};
+#else
+/// @brief Compiled out: empty and never captures anything
+class StackTrace final
+{
+public:
+  static constexpr std::size_t max_frames{ 0 };
+
+  void capture(std::size_t /*skip*/ = 0) {}
+  [[nodiscard]] std::span<const void *const> frames() const { return {}; }
+  [[nodiscard]] bool empty() const { return true; }
+  [[nodiscard]] std::string format() const { return {}; }
+  template<typename OutputIt> OutputIt format_to(OutputIt out) const { return out; }
+};
+#endif
+
+namespace detail {
+  template<typename E> constexpr StackPolicy stack_policy()
+  {
+    if constexpr (requires { E::stack_policy; }) {
+      return E::stack_policy;
+    } else {
+      return StackPolicy::always();
+    }
+  }
+
+  /// @brief Capture into trace as the policy of error type E says
+  template<typename E> void capture_stack([[maybe_unused]] StackTrace &trace)
+  {
+    if constexpr (ANYWHO_ENABLE_STACKTRACE != 0) {
+      constexpr StackPolicy policy = stack_policy<E>();
+      // Nothing is skipped, frames of error constructors that were not inlined are the first ones.
+      if constexpr (policy.every() == 1) {
+        trace.capture();
+      } else if constexpr (policy.every() > 1) {
+        thread_local std::uint32_t created{ 0 };
+        if (created++ % policy.every() == 0) { trace.capture(); }
+      }
+    }
+  }
+}// namespace detail
+
+}// namespace anywho
+
+/**
+ * @brief Formatter for StackTrace, one line per frame.
+ *
+ */
+template<> struct anywho::format_ns::formatter<anywho::StackTrace, char>
+{
+  constexpr auto parse(auto &ctx) { return ctx.begin(); }
+
+  auto format(const anywho::StackTrace &trace, auto &ctx) const { return trace.format_to(ctx.out()); }
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "context.hpp"
+#include "error_id.hpp"
+#include "error_registry.hpp"
+#include "errors.hpp"
+#include "fixed_string.hpp"
+#include "format.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace anywho {
+
+/**
+ * @brief Error declared by its message alone, without writing a class:
+ *        using IOError = anywho::StaticError<"IOError">;
+ *        std::expected<int, IOError> read();
+ *        Message, id and formatting are constexpr and the type is empty, so std::expected<T, IOError> is no bigger
+ *        than T plus the discriminator. Hence contexts are dropped, use StaticErrorWithContext to keep them.
+ *        The message is the name of the error, f.e. in the error_registry. Different messages are different types,
+ *        check them for colliding ids with anywho::unique_ids.
+ *
+ * @tparam Msg Message of the error
+ */
+template<StringLiteral Msg> class [[gnu::visibility("default")]] StaticError final
+{
+public:
+  static constexpr std::string_view static_message{ Msg.view() };
+  static constexpr std::string_view static_name{ Msg.view() };
+
+  [[nodiscard]] constexpr std::string format() const { return message(); }
+
+  /**
+   * @brief Write the message to an output iterator, there are no contexts to add.
+   *
+   * @tparam OutputIt Output iterator of char
+   * @param out Where to write to
+   * @return OutputIt Iterator past the last written char
+   */
+  template<typename OutputIt> constexpr OutputIt format_to(OutputIt out) const
+  {
+    return std::ranges::copy(static_message, out).out;
+  }
+
+  /// @brief Context is dropped, the error has no place to store it
+  constexpr void consume_context(Context && /*context*/) {}
+
+  [[nodiscard]] constexpr std::string message() const { return std::string{ static_message }; }
+  [[nodiscard]] constexpr ErrorId id() const { return static_id_v<StaticError>; }
+  [[nodiscard]] constexpr TypeKey type_key() const { return type_key_v<StaticError>; }
+  /// @brief Id, name, message and severity of the error type, registered on first use
+  [[nodiscard]] static const ErrorDescriptor &descriptor() { return describe<StaticError>(); }
+};
+
+/**
+ * @brief StaticError that keeps its contexts like GenericError, the first InlineContexts of them inside the error.
+ *        Message and id are still compile time constants.
+ *        using ParseError = anywho::StaticErrorWithContext<"ParseError">;
+ *
+ * @tparam Msg Message of the error
+ * @tparam InlineContexts Number of contexts that are stored without dynamic memory allocation
+ */
+template<StringLiteral Msg, std::size_t InlineContexts = 0>
+class [[gnu::visibility("default")]] StaticErrorWithContext final
+  : public WithStaticId<StaticErrorWithContext<Msg, InlineContexts>, BasicGenericError<InlineContexts>>
+{
+public:
+  static constexpr std::string_view static_message{ Msg.view() };
+  static constexpr std::string_view static_name{ Msg.view() };
+};
+
+}// namespace anywho
+
+/**
+ * @brief Formatter for StaticError, writes the message.
+ *
+ */
+template<anywho::StringLiteral Msg> struct anywho::format_ns::formatter<anywho::StaticError<Msg>, char>
+{
+  constexpr auto parse(auto &ctx) { return ctx.begin(); }
+
+  auto format(const anywho::StaticError<Msg> &error, auto &ctx) const { return error.format_to(ctx.out()); }
+};
@@ -0,0 +1,640 @@
+#pragma once
+
+#include "concepts.hpp"
+#include "context.hpp"
+#include "error_id.hpp"
+#include "error_registry.hpp"
+#include "errors.hpp"
+#include "fixed_string.hpp"
+#include "format.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+
+/**
+ * Versioned binary encoding of errors, for handing them between processes through pipes or shared memory.
+ * Integers are little endian and unaligned, so an encoding can start at any offset of a byte stream. Version 1:
+ *
+ *   magic         4 bytes  "AWHO"
+ *   version       u8       1
+ *   message kind  u8       0: inline text follows, 1: message of the id in the error_registry of the reader
+ *   file count    u16      number of distinct context files
+ *   size          u32      size of the whole encoding in bytes
+ *   id            u64
+ *   message       u32 size, bytes                            only for inline messages
+ *   file table    file count x (u32 offset, u32 size)        offsets from the start of the encoding
+ *   file names    bytes                                      every file name once, in order of first use
+ *   contexts      u32 count, count x (u16 file, u32 line, u32 size, bytes)
+ */
+namespace anywho::wire {
+
+inline constexpr std::uint8_t version{ 1 };
+
+/// @brief How the message of an error is encoded
+enum class MessageEncoding : std::uint8_t {
+  /// @brief The message text is part of the encoding
+  inline_text = 0,
+  /// @brief Only the id is sent, the reader takes the message from its error_registry. Falls back to inline_text if
+  ///        the id is not registered on the writing side.
+  registered = 1,
+};
+
+/// @brief Failures of encode and decode, reported as ErrorFromCode with wire_category()
+enum class WireErrc {
+  buffer_too_small = 1,
+  too_large,
+  truncated,
+  bad_magic,
+  unsupported_version,
+  malformed,
+  unknown_message,
+};
+
+class WireCategory final : public std::error_category
+{
+public:
+  [[nodiscard]] const char *name() const noexcept override { return "anywho.wire"; }
+  [[nodiscard]] std::string message(int code) const override
+  {
+    switch (static_cast<WireErrc>(code)) {
+    case WireErrc::buffer_too_small:
+      return "buffer too small for the encoded error";
+    case WireErrc::too_large:
+      return "error too large for the wire format";
+    case WireErrc::truncated:
+      return "encoded error is truncated";
+    case WireErrc::bad_magic:
+      return "not an encoded error";
+    case WireErrc::unsupported_version:
+      return "unsupported wire format version";
+    case WireErrc::malformed:
+      return "malformed encoded error";
+    case WireErrc::unknown_message:
+      return "message id is not registered";
+    }
+    return "unknown wire error";
+  }
+};
+
+inline const std::error_category &wire_category()
+{
+  static const WireCategory category;
+  return category;
+}
+
+inline std::error_code make_error_code(WireErrc code) { return { static_cast<int>(code), wire_category() }; }
+
+}// namespace anywho::wire
+
+template<> struct std::is_error_code_enum<anywho::wire::WireErrc> : std::true_type
+{
+};
+
+namespace anywho::wire {
+
+namespace detail {
+  inline constexpr std::array<char, 4> magic{ 'A', 'W', 'H', 'O' };
+  inline constexpr std::size_t header_size{ 20 };
+  inline constexpr std::size_t size_offset{ 8 };
+  inline constexpr std::size_t file_entry_size{ 8 };
+  inline constexpr std::size_t context_header_size{ 10 };
+  /// @brief Distinct file names decoding keeps alive, further ones are folded into the context message
+  inline constexpr std::size_t max_interned_files{ 1024 };
+
+  inline std::unexpected<ErrorFromCode> failure(WireErrc code)
+  {
+    return std::unexpected<ErrorFromCode>{ ErrorFromCode{ make_error_code(code) } };
+  }
+
+  /// @brief Writes into a fixed buffer and keeps counting once it is full, so that the needed size is known
+  class Writer
+  {
+  public:
+    explicit Writer(std::span<std::byte> out) : out_{ out } {}
+
+    template<std::unsigned_integral T> void put(T value)
+    {
+      for (std::size_t i = 0; i < sizeof(T); ++i) {
+        put_byte(static_cast<std::byte>(static_cast<unsigned char>(value >> (8U * i))));
+      }
+    }
+
+    void put_bytes(std::string_view bytes)
+    {
+      if (fits(bytes.size())) { std::memcpy(out_.data() + size_, bytes.data(), bytes.size()); }
+      size_ += bytes.size();
+    }
+
+    /// @brief u32 size followed by the bytes
+    void put_text(std::string_view text)
+    {
+      if (text.size() > std::numeric_limits<std::uint32_t>::max()) { too_large_ = true; }
+      put(static_cast<std::uint32_t>(text.size()));
+      put_bytes(text);
+    }
+
+    template<std::unsigned_integral T> void patch(std::size_t offset, T value)
+    {
+      Writer{ out_.subspan(offset, sizeof(T)) }.put(value);
+    }
+
+    [[nodiscard]] bool fits(std::size_t more = 0) const { return size_ + more <= out_.size(); }
+    [[nodiscard]] std::size_t size() const { return size_; }
+    [[nodiscard]] bool too_large() const { return too_large_; }
+    void set_too_large() { too_large_ = true; }
+    [[nodiscard]] std::span<const std::byte> written() const { return out_.first(size_); }
+
+  private:
+    void put_byte(std::byte value)
+    {
+      if (fits(1)) { out_[size_] = value; }
+      ++size_;
+    }
+
+    std::span<std::byte> out_;
+    std::size_t size_{ 0 };
+    bool too_large_{ false };
+  };
+
+  template<std::unsigned_integral T> T load(const std::byte *in)
+  {
+    T value{ 0 };
+    for (std::size_t i = 0; i < sizeof(T); ++i) {
+      value = static_cast<T>(value | (static_cast<T>(std::to_integer<unsigned char>(in[i])) << (8U * i)));
+    }
+    return value;
+  }
+
+  inline std::string_view text_at(const std::byte *in, std::size_t size)
+  {
+    return { reinterpret_cast<const char *>(in), size };
+  }
+
+  /// @brief Reads with bounds checks, every failed read sets the reader to failed
+  class Reader
+  {
+  public:
+    explicit Reader(std::span<const std::byte> in) : in_{ in } {}
+
+    template<std::unsigned_integral T> T get()
+    {
+      if (!fits(sizeof(T))) { return 0; }
+      const T value = load<T>(in_.data() + pos_);
+      pos_ += sizeof(T);
+      return value;
+    }
+
+    std::string_view get_text()
+    {
+      const auto size = get<std::uint32_t>();
+      if (!fits(size)) { return {}; }
+      const auto text = text_at(in_.data() + pos_, size);
+      pos_ += size;
+      return text;
+    }
+
+    void skip(std::size_t size)
+    {
+      if (fits(size)) { pos_ += size; }
+    }
+
+    [[nodiscard]] bool failed() const { return failed_; }
+    [[nodiscard]] std::size_t pos() const { return pos_; }
+
+  private:
+    bool fits(std::size_t size)
+    {
+      failed_ = failed_ || size > in_.size() - pos_;
+      return !failed_;
+    }
+
+    std::span<const std::byte> in_;
+    std::size_t pos_{ 0 };
+    bool failed_{ false };
+  };
+
+  /**
+   * @brief Contexts of an error as a span. GenericError keeps them structured, FixedSizeError only as formatted text,
+   *        which is handed out as a single context without file and line. Other errors have none.
+   *
+   */
+  template<typename E> std::span<const Context> contexts_of(const E &error, std::array<Context, 1> &flat)
+  {
+    if constexpr (requires { error.contexts(); }) {
+      const auto &chain = error.contexts();
+      return { chain.begin(), chain.size() };
+    } else if constexpr (requires { error.context_view(); }) {
+      std::string_view text = error.context_view();
+      if (text.empty()) { return {}; }
+      if (text.starts_with("::")) { text.remove_prefix(2); }
+      flat[0] = Context{ ContextText::from_static(text), 0, ContextFile{} };
+      return flat;
+    } else {
+      return {};
+    }
+  }
+
+  /// @brief True if no context before index has the same file
+  inline bool first_use_of_file(std::span<const Context> contexts, std::size_t index)
+  {
+    return std::none_of(contexts.begin(), contexts.begin() + static_cast<std::ptrdiff_t>(index),
+      [file = contexts[index].file()](const Context &el) { return el.file() == file; });
+  }
+
+  /// @brief Index of file in the file table that was already written
+  inline std::uint16_t file_index(const Writer &writer, std::size_t table, std::size_t count, std::string_view file)
+  {
+    const auto written = writer.written();
+    for (std::size_t i = 0; i < count; ++i) {
+      const std::byte *entry = written.data() + table + i * file_entry_size;
+      const auto offset = load<std::uint32_t>(entry);
+      const auto size = load<std::uint32_t>(entry + 4);
+      if (text_at(written.data() + offset, size) == file) { return static_cast<std::uint16_t>(i); }
+    }
+    return 0;
+  }
+
+  /**
+   * @brief Keeps decoded file names alive for the rest of the program, since contexts only reference their file.
+   *        Source files are few, so this stays small.
+   *
+   * @param file File name
+   * @return const char* Zero terminated copy, nullptr once max_interned_files names are kept
+   */
+  inline const char *intern_file(std::string_view file)
+  {
+    if (file.empty()) { return ""; }
+
+    static std::mutex mutex;
+    static std::set<std::string, std::less<>> files;
+    const std::scoped_lock lock{ mutex };
+    if (const auto found = files.find(file); found != files.end()) { return found->c_str(); }
+    if (files.size() >= max_interned_files) { return nullptr; }
+    return files.emplace(file).first->c_str();
+  }
+
+  template<typename Base> struct RemoteMessage
+  {
+    using type = std::string;
+  };
+  template<uint Size> struct RemoteMessage<FixedSizeError<Size>>
+  {
+    using type = FixedString<Size>;
+  };
+}// namespace detail
+
+namespace detail {
+  /// @brief Write the encoding, the writer keeps counting if the buffer is too small
+  template<typename E> void write_error(const E &error, Writer &writer, MessageEncoding encoding)
+  {
+    std::array<Context, 1> flat{};
+    const auto contexts = contexts_of(error, flat);
+    const ErrorId id = error.id();
+    if (encoding == MessageEncoding::registered && error_registry.find(id) == nullptr) {
+      encoding = MessageEncoding::inline_text;
+    }
+
+    std::size_t file_count = 0;
+    for (std::size_t i = 0; i < contexts.size(); ++i) {
+      if (first_use_of_file(contexts, i)) { ++file_count; }
+    }
+    if (file_count > std::numeric_limits<std::uint16_t>::max()
+        || contexts.size() > std::numeric_limits<std::uint32_t>::max()) {
+      writer.set_too_large();
+      return;
+    }
+
+    writer.put_bytes({ magic.data(), magic.size() });
+    writer.put(version);
+    writer.put(static_cast<std::uint8_t>(encoding));
+    writer.put(static_cast<std::uint16_t>(file_count));
+    writer.put(std::uint32_t{ 0 });// size, patched by encode
+    writer.put(std::uint64_t{ id });
+    if (encoding == MessageEncoding::inline_text) { writer.put_text(error.message()); }
+
+    const std::size_t table = writer.size();
+    std::size_t offset = table + file_count * file_entry_size;
+    for (std::size_t i = 0; i < contexts.size(); ++i) {
+      if (!first_use_of_file(contexts, i)) { continue; }
+      const auto size = contexts[i].file().size();
+      writer.put(static_cast<std::uint32_t>(offset));
+      writer.put(static_cast<std::uint32_t>(size));
+      offset += size;
+    }
+    for (std::size_t i = 0; i < contexts.size(); ++i) {
+      if (first_use_of_file(contexts, i)) { writer.put_bytes(contexts[i].file()); }
+    }
+
+    writer.put(static_cast<std::uint32_t>(contexts.size()));
+    for (const auto &el : contexts) {
+      // Indices are only needed if everything fits, the size is the same either way.
+      writer.put(writer.fits() ? file_index(writer, table, file_count, el.file()) : std::uint16_t{ 0 });
+      writer.put(static_cast<std::uint32_t>(el.line()));
+      writer.put_text(el.message());
+    }
+    if (writer.size() > std::numeric_limits<std::uint32_t>::max()) { writer.set_too_large(); }
+  }
+}// namespace detail
+
+/**
+ * @brief Encode an error into a caller supplied buffer. Apart from message() of errors without a static message
+ *        nothing allocates. File names are written once and referenced by the contexts.
+ *        Use like
+ *        std::array<std::byte, 4096> buffer{};
+ *        const auto size = ANYWHO(anywho::wire::encode(error, buffer));
+ *        write(pipe, buffer.data(), size);
+ *
+ * @tparam E Error type, contexts are kept for GenericError and FixedSizeError and everything derived from them
+ * @param error Error to encode
+ * @param out Buffer to write to
+ * @param encoding Whether to send the message text or only its id
+ * @return std::expected<std::size_t, ErrorFromCode> Bytes written, or WireErrc::buffer_too_small
+ */
+template<concepts::Error E>
+std::expected<std::size_t, ErrorFromCode>
+  encode(const E &error, std::span<std::byte> out, MessageEncoding encoding = MessageEncoding::inline_text)
+{
+  detail::Writer writer{ out };
+  detail::write_error(error, writer, encoding);
+  if (writer.too_large()) { return detail::failure(WireErrc::too_large); }
+  if (!writer.fits()) { return detail::failure(WireErrc::buffer_too_small); }
+  writer.patch(detail::size_offset, static_cast<std::uint32_t>(writer.size()));
+
+  return writer.size();
+}
+
+/**
+ * @brief Bytes encode needs for an error.
+ *
+ * @tparam E Error type
+ * @param error Error to encode
+ * @param encoding Whether to send the message text or only its id
+ * @return std::size_t
+ */
+template<concepts::Error E>
+std::size_t encoded_size(const E &error, MessageEncoding encoding = MessageEncoding::inline_text)
+{
+  detail::Writer writer{ {} };
+  detail::write_error(error, writer, encoding);
+  return writer.size();
+}
+
+/// @brief One decoded context, referencing the encoded bytes
+struct ContextView
+{
+  std::string_view file;
+  std::uint32_t line{ 0 };
+  std::string_view message;
+};
+
+/**
+ * @brief Contexts of a decoded error, innermost first. Iterating parses the records in place and never allocates.
+ *
+ */
+class ContextRange final
+{
+public:
+  class iterator
+  {
+  public:
+    using value_type = ContextView;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() = default;
+    iterator(const std::byte *pos, const std::byte *base, const std::byte *table)
+      : pos_{ pos }, base_{ base }, table_{ table }
+    {}
+
+    ContextView operator*() const
+    {
+      const std::byte *entry = table_ + detail::file_entry_size * detail::load<std::uint16_t>(pos_);
+      return { detail::text_at(base_ + detail::load<std::uint32_t>(entry), detail::load<std::uint32_t>(entry + 4)),
+        detail::load<std::uint32_t>(pos_ + 2),
+        detail::text_at(pos_ + detail::context_header_size, detail::load<std::uint32_t>(pos_ + 6)) };
+    }
+
+    iterator &operator++()
+    {
+      pos_ += detail::context_header_size + detail::load<std::uint32_t>(pos_ + 6);
+      return *this;
+    }
+    iterator operator++(int)
+    {
+      iterator out = *this;
+      ++*this;
+      return out;
+    }
+
+    bool operator==(const iterator &other) const { return pos_ == other.pos_; }
+
+  private:
+    const std::byte *pos_{ nullptr };
+    const std::byte *base_{ nullptr };
+    const std::byte *table_{ nullptr };
+  };
+
+  ContextRange() = default;
+  ContextRange(iterator first, iterator last, std::size_t count) : begin_{ first }, end_{ last }, size_{ count } {}
+
+  [[nodiscard]] iterator begin() const { return begin_; }
+  [[nodiscard]] iterator end() const { return end_; }
+  [[nodiscard]] std::size_t size() const { return size_; }
+  [[nodiscard]] bool empty() const { return size_ == 0; }
+
+private:
+  iterator begin_{};
+  iterator end_{};
+  std::size_t size_{ 0 };
+};
+
+/**
+ * @brief Error decoded in another process: GenericError or FixedSizeError with the id and message it was sent with.
+ *
+ * @tparam Base GenericError, BasicGenericError<N> or FixedSizeError<Size>
+ */
+template<typename Base = GenericError> class RemoteError final : public Base
+{
+public:
+  RemoteError(ErrorId id, std::string_view message) : message_{ message }, id_{ id } {}
+
+  [[nodiscard]] std::string message() const override { return std::string{ std::string_view{ message_ } }; }
+  [[nodiscard]] ErrorId id() const override { return id_; }
+
+private:
+  typename detail::RemoteMessage<Base>::type message_;
+  ErrorId id_;
+};
+
+class ErrorView;
+inline std::expected<ErrorView, ErrorFromCode> decode(std::span<const std::byte> in);
+
+/**
+ * @brief Decoded error that references the encoded bytes, which must outlive it. Decoding validates everything up
+ *        front, so reading the view afterwards cannot fail.
+ *
+ */
+class ErrorView final
+{
+public:
+  [[nodiscard]] ErrorId id() const { return id_; }
+  [[nodiscard]] std::string_view message() const { return message_; }
+  [[nodiscard]] const ContextRange &contexts() const { return contexts_; }
+  /// @brief Bytes of the encoding, where the next encoded error of a stream starts
+  [[nodiscard]] std::size_t size() const { return size_; }
+
+  /**
+   * @brief Write the error like format() of the encoded error, straight from the encoded bytes.
+   *
+   * @tparam OutputIt Output iterator of char
+   * @param out Where to write to
+   * @return OutputIt Iterator past the last written char
+   */
+  template<typename OutputIt> OutputIt format_to(OutputIt out) const
+  {
+    out = std::ranges::copy(message_, out).out;
+    for (const auto &el : contexts_) {
+      out = std::ranges::copy(std::string_view{ "::" }, out).out;
+      if (!el.file.empty() || el.line != 0) {
+        out = format_ns::format_to(out, "{}:{} -> ", el.file, el.line);
+      }
+      out = std::ranges::copy(el.message, out).out;
+    }
+
+    return out;
+  }
+
+  /**
+   * @brief Build an error with the same id, message and contexts as the encoded one. File names are interned, so
+   *        they allocate once per distinct name. Breadcrumbs of active ScopedContext guards come before the decoded
+   *        contexts.
+   *
+   * @tparam Base GenericError, BasicGenericError<N> or FixedSizeError<Size>
+   * @return RemoteError<Base>
+   */
+  template<typename Base = GenericError> [[nodiscard]] RemoteError<Base> to_error() const
+  {
+    // FixedSizeError formats contexts into its buffer right away, so their text is only referenced.
+    constexpr bool borrows_text =
+      decltype(anywho::detail::is_fixed_size_error_impl(std::declval<const Base *>()))::value;
+
+    RemoteError<Base> out{ id_, message_ };
+    for (const auto &el : contexts_) {
+      const char *file = detail::intern_file(el.file);
+      if (file == nullptr) {
+        out.consume_context(
+          Context{ ContextText{ format_ns::format("{}:{} -> {}", el.file, el.line, el.message) }, 0, ContextFile{} });
+      } else {
+        out.consume_context(Context{ borrows_text ? ContextText::from_static(el.message) : ContextText{ el.message },
+          el.line,
+          ContextFile::from_static(file) });
+      }
+    }
+    return out;
+  }
+
+private:
+  friend std::expected<ErrorView, ErrorFromCode> decode(std::span<const std::byte> in);
+
+  ErrorId id_{ 0 };
+  std::string_view message_;
+  ContextRange contexts_;
+  std::size_t size_{ 0 };
+};
+
+/**
+ * @brief Decode an error without copying or allocating.
+ *        Use like
+ *        const auto view = ANYWHO(anywho::wire::decode(received));
+ *        for (const auto &el : view.contexts()) { log(el.file, el.line, el.message); }
+ *        return std::unexpected(view.to_error());
+ *
+ * @param in Bytes starting with an encoded error, may continue with further data
+ * @return std::expected<ErrorView, ErrorFromCode>
+ */
+inline std::expected<ErrorView, ErrorFromCode> decode(std::span<const std::byte> in)
+{
+  if (in.size() < detail::header_size) { return detail::failure(WireErrc::truncated); }
+  if (!std::equal(detail::magic.begin(), detail::magic.end(), in.begin(), [](char lhs, std::byte rhs) {
+        return static_cast<unsigned char>(lhs) == std::to_integer<unsigned char>(rhs);
+      })) {
+    return detail::failure(WireErrc::bad_magic);
+  }
+  if (std::to_integer<std::uint8_t>(in[4]) != version) { return detail::failure(WireErrc::unsupported_version); }
+
+  const auto encoding = std::to_integer<std::uint8_t>(in[5]);
+  const auto file_count = detail::load<std::uint16_t>(in.data() + 6);
+  const auto size = detail::load<std::uint32_t>(in.data() + detail::size_offset);
+  if (size > in.size()) { return detail::failure(WireErrc::truncated); }
+  if (size < detail::header_size) { return detail::failure(WireErrc::malformed); }
+  in = in.first(size);
+
+  ErrorView out;
+  // Ids are as wide as size_t, 32 bit platforms read the low half.
+  out.id_ = detail::load<ErrorId>(in.data() + 12);
+  out.size_ = size;
+
+  detail::Reader reader{ in };
+  reader.skip(detail::header_size);
+  if (encoding == static_cast<std::uint8_t>(MessageEncoding::inline_text)) {
+    out.message_ = reader.get_text();
+  } else if (encoding == static_cast<std::uint8_t>(MessageEncoding::registered)) {
+    const auto *descriptor = error_registry.find(out.id_);
+    if (descriptor == nullptr) { return detail::failure(WireErrc::unknown_message); }
+    out.message_ = descriptor->message();
+  } else {
+    return detail::failure(WireErrc::malformed);
+  }
+  if (reader.failed()) { return detail::failure(WireErrc::truncated); }
+
+  // The table is read twice, so it must be complete before the first entry is looked at.
+  const std::size_t table = reader.pos();
+  if (std::size_t{ file_count } * detail::file_entry_size > size - table) {
+    return detail::failure(WireErrc::truncated);
+  }
+  for (std::size_t i = 0; i < file_count; ++i) {
+    const auto offset = reader.get<std::uint32_t>();
+    const auto length = reader.get<std::uint32_t>();
+    if (offset > size || length > size - offset) { return detail::failure(WireErrc::malformed); }
+  }
+  if (reader.failed()) { return detail::failure(WireErrc::truncated); }
+  // File names follow the table, the contexts follow the last file name.
+  std::size_t names_end = reader.pos();
+  for (std::size_t i = 0; i < file_count; ++i) {
+    const std::byte *entry = in.data() + table + i * detail::file_entry_size;
+    names_end = std::max<std::size_t>(
+      names_end, std::size_t{ detail::load<std::uint32_t>(entry) } + detail::load<std::uint32_t>(entry + 4));
+  }
+  reader.skip(names_end - reader.pos());
+
+  const auto count = reader.get<std::uint32_t>();
+  const std::size_t first = reader.pos();
+  for (std::size_t i = 0; i < count && !reader.failed(); ++i) {
+    const auto file = reader.get<std::uint16_t>();
+    if (!reader.failed() && file >= file_count) { return detail::failure(WireErrc::malformed); }
+    reader.get<std::uint32_t>();
+    reader.get_text();
+  }
+  if (reader.failed()) { return detail::failure(WireErrc::truncated); }
+  if (reader.pos() != size) { return detail::failure(WireErrc::malformed); }
+
+  const std::byte *table_data = in.data() + table;
+  out.contexts_ = ContextRange{
+    { in.data() + first, in.data(), table_data }, { in.data() + size, in.data(), table_data }, count
+  };
+  return out;
+}
+
+}// namespace anywho::wire
@@ -5,7 +5,14 @@
 #endif
 #include "context.hpp"
 #include "has_error.hpp"
+#include "propagation.hpp"
 #include <expected>
+#include <functional>
+#include <optional>
+#include <source_location>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 
 namespace anywho {
 /**
@@ -21,10 +28,13 @@ namespace anywho {
 template<typename V, concepts::Error E>
 inline std::expected<V, E> with_context(std::expected<V, E> &&exp, Context &&context)
 {
-  return exp.transform_error([cont = std::move(context)](auto x) mutable {
-    x.consume_context(std::move(cont));
-    return x;
-  });
+  // Add the context in place and move the result on, so the error is never copied.
+  if (has_error(exp)) {
+    exp.error().consume_context(std::move(context));
+    detail::on_context(exp.error());
+  }
+
+  return std::move(exp);
 }
 #endif
 
@@ -45,11 +55,141 @@ template<typename E>
 inline std::optional<E> with_context(std::optional<E> &&exp, Context &&context)
 {
   if (has_error(exp)) {
-    auto err = exp.value();
-    err.consume_context(std::move(context));
-    return std::optional{ err };
+    exp->consume_context(std::move(context));
+    detail::on_context(*exp);
+  }
+
+  return std::move(exp);
+}
+
+namespace detail {
+  /**
+   * @brief Turn what the callable of with_context_lazy returned into a Context. Contexts are taken as they are,
+   *        strings are copied and get the location of the call to with_context_lazy.
+   *
+   */
+  template<typename T> Context to_context(T &&made, const std::source_location &location)
+  {
+    if constexpr (std::is_same_v<std::remove_cvref_t<T>, Context>) {
+      return std::forward<T>(made);
+    } else {
+      return { ContextText{ std::string_view{ made } }, location };
+    }
+  }
+
+  template<typename F>
+  concept ContextMaker = std::invocable<F &>
+                         && (std::is_same_v<std::remove_cvref_t<std::invoke_result_t<F &>>, Context>
+                             || std::convertible_to<std::invoke_result_t<F &>, std::string_view>);
+}// namespace detail
+
+/**
+ * @brief Same as with_context, but the context is only made if exp holds an error. Use it when building the context
+ *        is expensive, f.e.
+ *        auto content = ANYWHO(anywho::with_context_lazy(readFile(path), [&path] { return describe(path); }));
+ *
+ * @tparam V Type of the expected value
+ * @tparam E Type of the error
+ * @tparam F Callable returning a Context or a string
+ * @param exp Object to which context will be added
+ * @param make_context Called only on the error path
+ * @param location Location used if make_context returns a string, defaults to the caller
+ * @return std::expected<V, E>
+ */
+#if __cplusplus > 202002L
+template<typename V, concepts::Error E, detail::ContextMaker F>
+inline std::expected<V, E> with_context_lazy(std::expected<V, E> &&exp,
+  F &&make_context,
+  const std::source_location &location = std::source_location::current())
+{
+  if (has_error(exp)) {
+    exp.error().consume_context(detail::to_context(std::invoke(make_context), location));
+    detail::on_context(exp.error());
+  }
+
+  return std::move(exp);
+}
+#endif
+
+/**
+ * @brief Same as with_context, but the context is only made if exp holds an error.
+ *
+ * @tparam E Type of the error
+ * @tparam F Callable returning a Context or a string
+ * @param exp Object to which context will be added
+ * @param make_context Called only on the error path
+ * @param location Location used if make_context returns a string, defaults to the caller
+ * @return std::optional<E>
+ */
+#if __cplusplus > 202002L
+template<concepts::Error E, detail::ContextMaker F>
+#else
+template<typename E, detail::ContextMaker F>
+#endif
+inline std::optional<E> with_context_lazy(std::optional<E> &&exp,
+  F &&make_context,
+  const std::source_location &location = std::source_location::current())
+{
+  if (has_error(exp)) {
+    exp->consume_context(detail::to_context(std::invoke(make_context), location));
+    detail::on_context(*exp);
+  }
+
+  return std::move(exp);
+}
+
+/**
+ * @brief Same as with_context, but the context message is formatted only if exp holds an error. The arguments are
+ *        taken by reference and the format string is checked at compile time, f.e.
+ *        auto content = ANYWHO(anywho::with_context_fmt(readFile(path), "Failed to read instrs from {}", path));
+ *
+ * @tparam V Type of the expected value
+ * @tparam E Type of the error
+ * @tparam Args Types of the format arguments
+ * @param exp Object to which context will be added
+ * @param fmt Format string of the context message
+ * @param args Format arguments
+ * @return std::expected<V, E>
+ */
+#if __cplusplus > 202002L
+template<typename V, concepts::Error E, typename... Args>
+inline std::expected<V, E> with_context_fmt(std::expected<V, E> &&exp,
+  detail::FormatWithLocation<std::type_identity_t<Args>...> fmt,
+  Args &&...args)
+{
+  if (has_error(exp)) {
+    exp.error().consume_context(detail::make_formatted_context(fmt.text, fmt.location, args...));
+    detail::on_context(exp.error());
+  }
+
+  return std::move(exp);
+}
+#endif
+
+/**
+ * @brief Same as with_context, but the context message is formatted only if exp holds an error.
+ *
+ * @tparam E Type of the error
+ * @tparam Args Types of the format arguments
+ * @param exp Object to which context will be added
+ * @param fmt Format string of the context message
+ * @param args Format arguments
+ * @return std::optional<E>
+ */
+#if __cplusplus > 202002L
+template<concepts::Error E, typename... Args>
+#else
+template<typename E, typename... Args>
+#endif
+inline std::optional<E> with_context_fmt(std::optional<E> &&exp,
+  detail::FormatWithLocation<std::type_identity_t<Args>...> fmt,
+  Args &&...args)
+{
+  if (has_error(exp)) {
+    exp->consume_context(detail::make_formatted_context(fmt.text, fmt.location, args...));
+    detail::on_context(*exp);
   }
 
-  return std::nullopt;
+  return std::move(exp);
 }
-}// namespace anywho
\ No newline at end of file
+}// namespace anywho
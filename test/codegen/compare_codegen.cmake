@@ -0,0 +1,95 @@
+# Compile SOURCE to assembly and check that every function factory_<name> in namespace codegen compiles to the code of
+# hand_<name>: it calls exactly the same functions and has at most SLACK_PERCENT (default 3) percent more instructions.
+# The instructions are not compared one by one, the register allocator and the block layout differ in details between
+# otherwise equal functions. Type erasure or extra copies show up as calls. Assembler directives are dropped, local
+# labels and the names of the functions themselves normalized.
+#
+# cmake -DCXX=<compiler> -DSOURCE=<file> -DINCLUDE_DIR=<dir> -DOUTPUT=<file.s> [-DFLAGS=<flags>] [-DSLACK_PERCENT=<n>]
+#       -P compare_codegen.cmake
+
+foreach(var CXX SOURCE INCLUDE_DIR OUTPUT)
+  if(NOT DEFINED ${var})
+    message(FATAL_ERROR "${var} is not set")
+  endif()
+endforeach()
+
+if(NOT DEFINED SLACK_PERCENT)
+  set(SLACK_PERCENT 3)
+endif()
+
+separate_arguments(extra_flags UNIX_COMMAND "${FLAGS}")
+# gcc folds identical functions, which would turn equal pairs into a jump from one to the other
+execute_process(COMMAND ${CXX} --version OUTPUT_VARIABLE version)
+if(NOT version MATCHES "clang")
+  list(APPEND extra_flags -fno-ipa-icf)
+endif()
+execute_process(
+  COMMAND ${CXX} -std=c++23 -O2 -fno-asynchronous-unwind-tables -fno-lto -S -I${INCLUDE_DIR}
+          ${extra_flags} ${SOURCE} -o ${OUTPUT}
+  RESULT_VARIABLE result
+  ERROR_VARIABLE errors)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "Compiling ${SOURCE} failed:\n${errors}")
+endif()
+
+file(STRINGS ${OUTPUT} lines)
+
+# Instructions of the function with the mangled name symbol and of its cold part, and the sorted calls among them
+function(extract_instructions symbol out_var calls_var)
+  set(instructions "")
+  set(calls "")
+  set(inside FALSE)
+  foreach(line IN LISTS lines)
+    if(line MATCHES "^(${symbol}|${symbol}\\.cold):$")
+      set(inside TRUE)
+    elseif(inside AND line MATCHES "^\t\\.size\t")
+      set(inside FALSE)
+    elseif(inside AND NOT line MATCHES "^\t\\." AND NOT line STREQUAL "")
+      string(REGEX REPLACE "\\.L[A-Za-z0-9_]+" ".L" line "${line}")
+      string(REPLACE "${symbol}" "FUNCTION" line "${line}")
+      list(APPEND instructions "${line}")
+      if(line MATCHES "^\t(call|jmp)\t[^.]")
+        list(APPEND calls "${line}")
+      endif()
+    endif()
+  endforeach()
+  list(SORT calls)
+  set(${out_var} "${instructions}" PARENT_SCOPE)
+  set(${calls_var} "${calls}" PARENT_SCOPE)
+endfunction()
+
+set(pairs 0)
+set(failures "")
+foreach(line IN LISTS lines)
+  if(line MATCHES "^(_ZN7codegen[0-9]+factory_([A-Za-z0-9_]+)E[A-Za-z0-9_]*):$")
+    set(factory_symbol ${CMAKE_MATCH_1})
+    set(name ${CMAKE_MATCH_2})
+    string(LENGTH "hand_${name}" length)
+    string(REGEX REPLACE "^_ZN7codegen[0-9]+factory_${name}" "_ZN7codegen${length}hand_${name}" hand_symbol
+                         "${factory_symbol}")
+
+    extract_instructions(${factory_symbol} factory factory_calls)
+    extract_instructions(${hand_symbol} hand hand_calls)
+    list(LENGTH factory factory_count)
+    list(LENGTH hand hand_count)
+    math(EXPR allowed_count "${hand_count} + ${hand_count} * ${SLACK_PERCENT} / 100")
+    if(hand STREQUAL "")
+      list(APPEND failures "${name}: hand_${name} is missing")
+    elseif(NOT factory_calls STREQUAL hand_calls)
+      list(JOIN factory_calls "\n" factory_calls)
+      list(APPEND failures "${name}: the factory calls other functions:\n${factory_calls}")
+    elseif(factory_count GREATER allowed_count)
+      list(APPEND failures "${name}: ${factory_count} instructions for the factory, ${hand_count} by hand")
+    endif()
+    math(EXPR pairs "${pairs} + 1")
+  endif()
+endforeach()
+
+if(pairs EQUAL 0)
+  message(FATAL_ERROR "No factory_ functions found in ${OUTPUT}")
+endif()
+if(NOT failures STREQUAL "")
+  list(JOIN failures "\n" failures)
+  message(FATAL_ERROR "Factories that do not compile to the hand written code, see ${OUTPUT}:\n${failures}")
+endif()
+message(STATUS "${pairs} factories compile to the hand written code")
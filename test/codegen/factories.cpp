@@ -0,0 +1,125 @@
+// Pairs of functions that compare_codegen.cmake compiles to assembly: every factory_<name> must compile to the same
+// instructions as hand_<name>, the if/else a user would write without the error factories.
+#include "error_factories.hpp"
+#include "errors.hpp"
+#include <expected>
+#include <system_error>
+#include <tuple>
+
+// Legacy functions, only declared so that the compiler can not look through them
+bool legacy_square(int value, int &out);
+std::error_code legacy_square_with_code(int value, int &out);
+int legacy_square_with_status(int value, int *out);
+long legacy_read(int value);
+
+namespace codegen {
+
+using Code = std::expected<int, anywho::ErrorFromCode>;
+
+std::expected<int, anywho::GenericError> hand_bool(int value)
+{
+  int out = 0;
+  if (legacy_square(value, out)) { return out; }
+  return std::unexpected(anywho::GenericError{});
+}
+
+std::expected<int, anywho::GenericError> factory_bool(int value)
+{
+  int out = 0;
+  const bool success = legacy_square(value, out);
+  return anywho::make_error(success, out, [] { return anywho::GenericError{}; });
+}
+
+std::expected<int, anywho::GenericError> hand_bool_eager(int value)
+{
+  int out = 0;
+  const bool success = legacy_square(value, out);
+  anywho::GenericError error{};
+  if (success) { return out; }
+  return std::unexpected(std::move(error));
+}
+
+std::expected<int, anywho::GenericError> factory_bool_eager(int value)
+{
+  int out = 0;
+  const bool success = legacy_square(value, out);
+  return anywho::make_error(success, out, anywho::GenericError{});
+}
+
+std::expected<int, anywho::GenericError> hand_bool_callable(int value)
+{
+  int out = 0;
+  if (legacy_square(value, out)) { return out; }
+  return std::unexpected(anywho::GenericError{});
+}
+
+std::expected<int, anywho::GenericError> factory_bool_callable(int value)
+{
+  return anywho::make_error(
+    [value] {
+      int out = 0;
+      const bool success = legacy_square(value, out);
+      return std::tuple{ success, out };
+    },
+    [] { return anywho::GenericError{}; });
+}
+
+Code hand_error_code(int value)
+{
+  int out = 0;
+  const std::error_code code = legacy_square_with_code(value, out);
+  if (!code) { return out; }
+  return std::unexpected(anywho::ErrorFromCode(code));
+}
+
+Code factory_error_code(int value)
+{
+  int out = 0;
+  const std::error_code code = legacy_square_with_code(value, out);
+  return anywho::make_error(code, out);
+}
+
+Code hand_error_code_callable(int value)
+{
+  int out = 0;
+  const std::error_code code = legacy_square_with_code(value, out);
+  if (!code) { return out; }
+  return std::unexpected(anywho::ErrorFromCode(code));
+}
+
+Code factory_error_code_callable(int value)
+{
+  return anywho::make_error([value] {
+    int out = 0;
+    const std::error_code code = legacy_square_with_code(value, out);
+    return std::tuple{ code, out };
+  });
+}
+
+std::expected<long, anywho::ErrorFromCode> hand_errno(int value)
+{
+  const long result = legacy_read(value);
+  if (result != -1) { return result; }
+  return std::unexpected(anywho::ErrorFromCode(std::error_code{ errno, std::generic_category() }));
+}
+
+std::expected<long, anywho::ErrorFromCode> factory_errno(int value)
+{
+  return anywho::make_error_from_errno(legacy_read(value));
+}
+
+Code hand_out(int value)
+{
+  int out = 0;
+  const int status = legacy_square_with_status(value, &out);
+  if (status == 0) { return out; }
+  return std::unexpected(anywho::ErrorFromCode(
+    std::error_code{ status == -1 ? errno : status, std::generic_category() }));
+}
+
+Code factory_out(int value)
+{
+  return anywho::make_error_from_out<int>([value](int &out) { return legacy_square_with_status(value, &out); });
+}
+
+}// namespace codegen
@@ -1,10 +1,27 @@
 #include "anywho.hpp"
 #include "context.hpp"
 #include "extra.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <catch2/catch_test_macros.hpp>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
 #include <expected>
 #include <format>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace {
 namespace direct_return_expected {
@@ -225,8 +242,7 @@ TEST_CASE("test truth/false error factor, false case", "[error_factories]")
 
 TEST_CASE("test truth/false error factor with function, false case", "[error_factories]")
 {
-  // Somehow template argument deduction does not work here, so we need to give it by hand.
-  const std::expected<int, anywho::GenericError> exp = anywho::make_error<int, anywho::GenericError>(
+  const std::expected<int, anywho::GenericError> exp = anywho::make_error(
     []() {
       int output = 0;
       bool ret = positiveOnlySquare(-3, output);
@@ -251,8 +267,7 @@ TEST_CASE("test truth/false error factor, truth case", "[error_factories]")
 
 TEST_CASE("test truth/false error factor with function, truth case", "[error_factories]")
 {
-  // Somehow template argument deduction does not work here, so we need to give it by hand.
-  const std::expected<int, anywho::GenericError> exp = anywho::make_error<int, anywho::GenericError>(
+  const std::expected<int, anywho::GenericError> exp = anywho::make_error(
     []() {
       int output = 0;
       bool ret = positiveOnlySquare(3, output);
@@ -283,8 +298,7 @@ TEST_CASE("test error from code factory, truth case", "[error_factories]")
 
 TEST_CASE("test error from code factory with function, false case", "[error_factories]")
 {
-  // Somehow template argument deduction does not work here, so we need to give it by hand.
-  std::expected<int, anywho::ErrorFromCode> exp = anywho::make_error<int>([]() {
+  std::expected<int, anywho::ErrorFromCode> exp = anywho::make_error([]() {
     int output = 0;
     auto ret = positiveOnlySquareWithErrorCode(-3, output);
     return std::make_tuple(ret, output);
@@ -295,8 +309,7 @@ TEST_CASE("test error from code factory with function, false case", "[error_fact
 
 TEST_CASE("test error from code factory with function, truth case", "[error_factories]")
 {
-  // Somehow template argument deduction does not work here, so we need to give it by hand.
-  std::expected<int, anywho::ErrorFromCode> exp = anywho::make_error<int>([]() {
+  std::expected<int, anywho::ErrorFromCode> exp = anywho::make_error([]() {
     int output = 0;
     auto ret = positiveOnlySquareWithErrorCode(3, output);
     return std::make_tuple(ret, output);
@@ -342,6 +355,43 @@ TEST_CASE("test error from throwable factory, truth case", "[error_factories]")
   }
 }
 
+namespace {
+int parseDigit(char digit)
+{
+  if (digit == 'x') { throw std::invalid_argument("not a digit: x"); }
+  if (digit < '0' || digit > '9') { throw std::out_of_range(std::string(200, digit)); }
+  return digit - '0';
+}
+}// namespace
+
+TEST_CASE("test error from throwable factory with several exceptions", "[error_factories]")
+{
+  const auto parse = [](char digit) {
+    return anywho::make_error_from_throwable<int, std::invalid_argument, std::logic_error>(
+      [digit] { return parseDigit(digit); });
+  };
+  REQUIRE(parse('7').value() == 7);
+
+  const auto invalid = parse('x');
+  REQUIRE(invalid.error().id() == anywho::ErrorFromException::id_of<std::invalid_argument>());
+  REQUIRE(invalid.error().what() == "not a digit: x");
+  REQUIRE(invalid.error().message() == "error happened with exception 'not a digit: x'");
+
+  // Caught as the base class, but not sliced: what() is kept and rethrowing gives the original type
+  const auto out_of_range = parse('#');
+  REQUIRE(out_of_range.error().id() == anywho::ErrorFromException::id_of<std::logic_error>());
+  REQUIRE(out_of_range.error().id() != invalid.error().id());
+  REQUIRE(out_of_range.error().what() == std::string(anywho::ErrorFromException::what_capacity, '#'));
+  REQUIRE_THROWS_AS(std::rethrow_exception(out_of_range.error().get_exception_ptr()), std::out_of_range);
+
+  const std::expected<void, anywho::ErrorFromException> nothing =
+    anywho::make_error_from_throwable<void, std::runtime_error>([] { positiveOnlySquareWithException(-3); });
+  REQUIRE(nothing.error().what() == "is negative");
+
+  REQUIRE_THROWS_AS((anywho::make_error_from_throwable<int, std::runtime_error>([] { return parseDigit('x'); })),
+    std::invalid_argument);
+}
+
 TEST_CASE("test optional<Error> factory, truth case", "[error_factories]")
 {
   int output = 0;
@@ -363,8 +413,7 @@ TEST_CASE("test optional<Error> factory, error case", "[error_factories]")
 
 TEST_CASE("test optional<Error> factory with function, truth case", "[error_factories]")
 {
-  // Somehow template argument deduction does not work here, so we need to give it by hand.
-  std::expected<int, DummyError> exp = anywho::make_error<int, DummyError>([]() {
+  std::expected<int, DummyError> exp = anywho::make_error([]() {
     int output = 0;
     auto ret = positiveOnlySquareWithOptional(3, output);
     return std::make_tuple(ret, output);
@@ -375,11 +424,1743 @@ TEST_CASE("test optional<Error> factory with function, truth case", "[error_fact
 
 TEST_CASE("test optional<Error> factory with function, error case", "[error_factories]")
 {
-  // Somehow template argument deduction does not work here, so we need to give it by hand.
-  std::expected<int, DummyError> exp = anywho::make_error<int, DummyError>([]() {
+  std::expected<int, DummyError> exp = anywho::make_error([]() {
     int output = 0;
     auto ret = positiveOnlySquareWithOptional(-3, output);
     return std::make_tuple(ret, output);
   });
   REQUIRE(!exp.has_value());
-}
\ No newline at end of file
+}
+
+namespace {
+// errno style, like read: -1 and errno on failure
+int legacyDup(int value)
+{
+  if (value < 0) {
+    errno = EBADF;
+    return -1;
+  }
+  return value;
+}
+
+// status style, like pthread functions: 0 or the errno value, result through an out parameter
+int legacyStatusSquare(int value, int *out)
+{
+  if (value < 0) { return EINVAL; }
+  *out = value * value;
+  return 0;
+}
+}// namespace
+
+TEST_CASE("test errno and out parameter factories", "[error_factories]")
+{
+  SECTION("errno")
+  {
+    const std::expected<int, anywho::ErrorFromCode> exp = anywho::make_error_from_errno(legacyDup(3));
+    REQUIRE(exp.value() == 3);
+
+    const std::expected<int, anywho::ErrorFromCode> failed = anywho::make_error_from_errno(legacyDup(-3));
+    REQUIRE(failed.error().get_code() == std::errc::bad_file_descriptor);
+  }
+
+  SECTION("status")
+  {
+    int output = 0;
+    const auto exp = anywho::make_error_from_status(legacyStatusSquare(3, &output), output);
+    static_assert(std::is_same_v<decltype(exp), const std::expected<int, anywho::ErrorFromCode>>);
+    REQUIRE(exp.value() == 9);
+
+    REQUIRE(anywho::make_error_from_status(legacyStatusSquare(-3, &output), output).error().get_code()
+            == std::errc::invalid_argument);
+    errno = ENOENT;
+    REQUIRE(anywho::make_error_from_status(-1, 0).error().get_code() == std::errc::no_such_file_or_directory);
+  }
+
+  SECTION("out parameter")
+  {
+    const auto exp = anywho::make_error_from_out<int>([](int &out) { return legacyStatusSquare(3, &out); });
+    REQUIRE(exp.value() == 9);
+
+    const auto failed = anywho::make_error_from_out<int>([](int &out) { return legacyStatusSquare(-3, &out); });
+    REQUIRE(failed.error().get_code() == std::errc::invalid_argument);
+
+    const auto from_code = anywho::make_error_from_out<int>(
+      [](int &out) { return positiveOnlySquareWithErrorCode(-3, out); });
+    REQUIRE(from_code.error().get_code() == std::errc::result_out_of_range);
+
+    const std::expected<int, anywho::GenericError> from_bool =
+      anywho::make_error_from_out<int>([](int &out) { return positiveOnlySquare(3, out); }, anywho::GenericError{});
+    REQUIRE(from_bool.value() == 9);
+  }
+
+  SECTION("error created on failure only")
+  {
+    int created = 0;
+    const auto make = [&created] {
+      ++created;
+      return anywho::GenericError{};
+    };
+    REQUIRE(anywho::make_error(true, 3, make).value() == 3);
+    REQUIRE(created == 0);
+    REQUIRE(!anywho::make_error(false, 3, make).has_value());
+    REQUIRE(created == 1);
+  }
+
+  SECTION("move only values")
+  {
+    auto exp = anywho::make_error(true, std::make_unique<int>(3), anywho::GenericError{});
+    static_assert(std::is_same_v<decltype(exp), std::expected<std::unique_ptr<int>, anywho::GenericError>>);
+    REQUIRE(**exp == 3);
+
+    auto from_callable =
+      anywho::make_error([] { return std::tuple{ std::error_code{}, std::make_unique<int>(4) }; });
+    REQUIRE(**from_callable == 4);
+  }
+}
+namespace {
+class StaticIdError final : public anywho::WithStaticId<StaticIdError>
+{
+public:
+  static constexpr std::string_view static_message{ "static id error" };
+};
+
+class OtherStaticIdError final : public anywho::WithStaticId<OtherStaticIdError, anywho::FixedSizeError<128>>
+{
+public:
+  static constexpr std::string_view static_message{ "other static id error" };
+};
+
+struct CollidingStaticIdError
+{
+  static constexpr std::string_view static_message{ "static id error" };
+};
+}// namespace
+
+TEST_CASE("test compile time error ids", "[error_id]")
+{
+  // FNV-1a reference values
+  STATIC_REQUIRE(anywho::hash_id("") == 14695981039346656037ULL);
+  STATIC_REQUIRE(anywho::hash_id("a") == 12638187200555641996ULL);
+  STATIC_REQUIRE(anywho::unique_ids<StaticIdError, OtherStaticIdError>());
+  STATIC_REQUIRE(!anywho::unique_ids<StaticIdError, OtherStaticIdError, CollidingStaticIdError>());
+
+  const StaticIdError err{};
+  REQUIRE(err.id() == anywho::static_id_v<StaticIdError>);
+  REQUIRE(err.id() == anywho::hash_id(err.message()));
+  REQUIRE(err.message() == "static id error");
+
+  const OtherStaticIdError other{};
+  REQUIRE(other.id() == anywho::hash_id("other static id error"));
+  REQUIRE(other.id() != err.id());
+
+  const anywho::GenericError generic{};
+  REQUIRE(generic.id() == anywho::hash_id(generic.message()));
+}
+
+namespace {
+using IOError = anywho::StaticError<"IOError">;
+using ParseError = anywho::StaticErrorWithContext<"ParseError", 2>;
+
+std::expected<int, IOError> readValue(bool fail)
+{
+  if (fail) { return std::unexpected(IOError{}); }
+  return 3;
+}
+
+std::expected<int, IOError> doubleValue(bool fail)
+{
+  const int value = ANYWHO(anywho::with_context(readValue(fail), { "reading" }));
+  return 2 * value;
+}
+
+std::expected<int, ParseError> parseValue()
+{
+  return anywho::with_context(std::expected<int, ParseError>{ std::unexpect }, { "parsing" });
+}
+}// namespace
+
+TEST_CASE("static errors", "[StaticError]")
+{
+  STATIC_REQUIRE(std::is_empty_v<IOError>);
+  STATIC_REQUIRE(std::is_trivially_copyable_v<IOError>);
+  STATIC_REQUIRE(sizeof(std::expected<int, IOError>) == sizeof(std::optional<int>));
+  STATIC_REQUIRE(anywho::concepts::Error<IOError>);
+  STATIC_REQUIRE(anywho::concepts::Error<ParseError>);
+  STATIC_REQUIRE(IOError{}.id() == anywho::hash_id("IOError"));
+  STATIC_REQUIRE(IOError::static_message == "IOError");
+  STATIC_REQUIRE([] {
+    std::array<char, 7> written{};
+    IOError{}.format_to(written.begin());
+    return std::string_view{ written.data(), written.size() } == "IOError";
+  }());
+  STATIC_REQUIRE(anywho::unique_ids<IOError, ParseError, anywho::StaticError<"TimeoutError">>());
+  STATIC_REQUIRE(!anywho::unique_ids<IOError, StaticIdError, anywho::StaticError<"static id error">>());
+
+  REQUIRE(doubleValue(false).value() == 6);
+  const auto failed = doubleValue(true);
+  REQUIRE(failed.error().id() == anywho::static_id_v<IOError>);
+  REQUIRE(std::format("{}", failed.error()) == "IOError");
+  REQUIRE(IOError{}.message() == "IOError");
+  REQUIRE(IOError{}.format() == "IOError");
+
+  const auto parsed = parseValue();
+  REQUIRE(parsed.error().id() == anywho::hash_id("ParseError"));
+  REQUIRE(parsed.error().message() == "ParseError");
+  REQUIRE(parsed.error().contexts().size() == 1);
+  REQUIRE(parsed.error().format().starts_with("ParseError::"));
+
+  REQUIRE(IOError::descriptor().name() == "IOError");
+  REQUIRE(anywho::error_registry.find(anywho::static_id_v<IOError>) == &IOError::descriptor());
+}
+
+TEST_CASE("compact context", "[context]")
+{
+  STATIC_REQUIRE(sizeof(anywho::Context) <= 4 * sizeof(void *));
+
+  const anywho::Context literal{ "literal" };
+  REQUIRE(literal.message() == "literal");
+  REQUIRE(literal.line() > 0);
+  REQUIRE(literal.file().contains("tests.cpp"));
+
+  anywho::Context runtime{};
+  {
+    std::string message = "runtime message that is longer than the small string buffer";
+    runtime = anywho::Context{ { .message = message, .line = 3, .file = "runtime.cpp" } };
+    message.assign(message.size(), 'x');
+  }
+  const anywho::Context copy = runtime;
+  REQUIRE(runtime.format() == "runtime.cpp:3 -> runtime message that is longer than the small string buffer");
+  REQUIRE(copy.format() == runtime.format());
+
+  const anywho::ContextText static_text{ "abc" };
+  const anywho::ContextText owned_text{ std::string_view{ "abc" } };
+  REQUIRE(static_text.is_static());
+  REQUIRE(!owned_text.is_static());
+  REQUIRE(static_text.view() == owned_text.view());
+}
+
+TEST_CASE("test BasicGenericError inline contexts", "[errors]")
+{
+  anywho::BasicGenericError<2> err{};
+  constexpr int line = 76;
+  err.consume_context(anywho::Context{ { .message = "abc", .line = line, .file = "tests.cpp" } });
+  err.consume_context(anywho::Context{ { .message = "abc2", .line = line + 1, .file = "tests.cpp" } });
+  REQUIRE(err.contexts().is_inline());
+  REQUIRE(err.format() == err.message() + "::tests.cpp:76 -> abc::tests.cpp:77 -> abc2");
+
+  const anywho::BasicGenericError<2> inline_copy = err;
+  err.consume_context(anywho::Context{ { .message = "abc3", .line = line + 2, .file = "tests.cpp" } });
+  REQUIRE(!err.contexts().is_inline());
+  REQUIRE(err.contexts().size() == 3);
+  REQUIRE(err.format() == inline_copy.format() + "::tests.cpp:78 -> abc3");
+
+  const anywho::BasicGenericError<2> heap_copy = err;
+  const anywho::BasicGenericError<2> moved = std::move(err);
+  REQUIRE(moved.format() == heap_copy.format());
+  REQUIRE(inline_copy.contexts().size() == 2);
+}
+
+namespace {
+class FirstContextsError final : public anywho::WithStaticId<FirstContextsError>
+{
+public:
+  static constexpr std::string_view static_message{ "first contexts error" };
+  static constexpr anywho::ContextPolicy context_policy{ anywho::ContextPolicy::keep_first(2) };
+};
+
+class LastContextsError final : public anywho::WithStaticId<LastContextsError, anywho::BasicGenericError<2>>
+{
+public:
+  static constexpr std::string_view static_message{ "last contexts error" };
+  static constexpr anywho::ContextPolicy context_policy{ anywho::ContextPolicy::keep_last(2) };
+};
+
+class RetryError final : public anywho::WithStaticId<RetryError>
+{
+public:
+  static constexpr std::string_view static_message{ "retry error" };
+  static constexpr anywho::ContextPolicy context_policy{ anywho::ContextPolicy::keep_ends(1, 2).collapsed() };
+};
+
+anywho::Context numbered(uint line) { return anywho::Context{ "step", line, "steps.cpp" }; }
+
+std::expected<int, RetryError> descend(int depth)
+{
+  if (depth == 0) { return std::unexpected(RetryError{}); }
+  return anywho::with_context(descend(depth - 1), { "descending" });
+}
+}// namespace
+
+TEST_CASE("context policies", "[context]")
+{
+  SECTION("keep first")
+  {
+    FirstContextsError err{};
+    for (uint line = 1; line <= 5; ++line) { err.consume_context(numbered(line)); }
+    REQUIRE(err.contexts().size() == 3);
+    REQUIRE(err.contexts()[1].line() == 2);
+    REQUIRE(err.contexts()[2].elided() == 3);
+    REQUIRE(err.format() == "first contexts error::steps.cpp:1 -> step::steps.cpp:2 -> step::...elided 3 contexts...");
+  }
+
+  SECTION("keep last")
+  {
+    LastContextsError err{};
+    for (uint line = 1; line <= 5; ++line) { err.consume_context(numbered(line)); }
+    REQUIRE(err.contexts().size() == 3);
+    REQUIRE(err.contexts()[0].is_elision());
+    REQUIRE(err.contexts()[1].line() == 4);
+    REQUIRE(err.contexts()[2].line() == 5);
+    REQUIRE(err.format() == "last contexts error::...elided 3 contexts...::steps.cpp:4 -> step::steps.cpp:5 -> step");
+
+    const LastContextsError copy = err;
+    REQUIRE(copy.format() == err.format());
+  }
+
+  SECTION("keep both ends and collapse repeats")
+  {
+    const auto failed = descend(1000);
+    const auto &contexts = failed.error().contexts();
+    REQUIRE(contexts.size() == 1);
+    REQUIRE(contexts[0].repeats() == 1000);
+    REQUIRE(failed.error().format().ends_with("-> descending (repeated 1000 times)"));
+
+    RetryError err{};
+    for (uint line = 1; line <= 6; ++line) {
+      err.consume_context(numbered(line));
+      err.consume_context(numbered(line));
+    }
+    REQUIRE(err.contexts().size() == 4);
+    REQUIRE(err.contexts()[0].line() == 1);
+    REQUIRE(err.contexts()[1].elided() == 6);
+    REQUIRE(err.format().contains("::...elided 6 contexts...::"));
+    REQUIRE(err.contexts()[3].line() == 6);
+    REQUIRE(err.contexts()[3].repeats() == 2);
+    REQUIRE(err.format().ends_with("::steps.cpp:6 -> step (repeated 2 times)"));
+  }
+
+  SECTION("unbounded by default")
+  {
+    anywho::GenericError err{};
+    for (int i = 0; i < 100; ++i) { err.consume_context(numbered(1)); }
+    REQUIRE(err.contexts().size() == 100);
+    REQUIRE(err.contexts()[99].repeats() == 1);
+  }
+}
+
+namespace {
+struct IgnoredContextPolicyError : anywho::GenericError
+{
+  static constexpr anywho::ContextPolicy context_policy{ anywho::ContextPolicy::keep_first(1) };
+};
+
+struct IgnoredStackPolicyError : anywho::FixedSizeError<64>
+{
+  static constexpr anywho::StackPolicy stack_policy{ anywho::StackPolicy::never() };
+};
+
+class OwnPolicyError : public anywho::GenericError
+{
+public:
+  using policy_owner = OwnPolicyError;
+  static constexpr anywho::ContextPolicy context_policy{ anywho::ContextPolicy::keep_first(1) };
+
+  OwnPolicyError() : anywho::GenericError(std::type_identity<OwnPolicyError>{}) {}
+};
+}// namespace
+
+TEST_CASE("policies of direct subclasses are rejected", "[context]")
+{
+  STATIC_REQUIRE(!anywho::detail::applies_context_policy<IgnoredContextPolicyError>);
+  STATIC_REQUIRE(!anywho::detail::applies_stack_policy<IgnoredStackPolicyError>);
+  STATIC_REQUIRE(anywho::detail::applies_context_policy<FirstContextsError>);
+  STATIC_REQUIRE(anywho::detail::applies_context_policy<anywho::GenericError>);
+  STATIC_REQUIRE(anywho::detail::applies_stack_policy<anywho::FixedSizeError<64>>);
+
+  STATIC_REQUIRE(anywho::detail::applies_context_policy<OwnPolicyError>);
+  std::expected<int, OwnPolicyError> failed{ std::unexpect };
+  for (uint line = 1; line <= 3; ++line) { failed = anywho::with_context(std::move(failed), numbered(line)); }
+  REQUIRE(failed.error().contexts().size() == 2);
+  REQUIRE(failed.error().contexts()[1].elided() == 2);
+}
+
+namespace {
+struct CopyCountingError
+{
+  CopyCountingError() = default;
+  CopyCountingError(const CopyCountingError &other) : contexts_{ other.contexts_ } { ++copies; }
+  CopyCountingError(CopyCountingError &&) noexcept = default;
+  CopyCountingError &operator=(const CopyCountingError &other)
+  {
+    contexts_ = other.contexts_;
+    ++copies;
+    return *this;
+  }
+  CopyCountingError &operator=(CopyCountingError &&) noexcept = default;
+  ~CopyCountingError() = default;
+
+  [[nodiscard]] static std::string format() { return "copy counting"; }
+  void consume_context(anywho::Context &&context) { contexts_.emplace_back(std::move(context)); }
+  [[nodiscard]] static std::string message() { return "copy counting error"; }
+  [[nodiscard]] static size_t id() { return 1; }
+
+  static inline int copies = 0;
+  std::vector<anywho::Context> contexts_;
+};
+
+struct MoveOnlyError
+{
+  [[nodiscard]] std::string format() const { return std::format("move only {}", *payload_); }
+  void consume_context(anywho::Context &&context) { contexts_.emplace_back(std::move(context)); }
+  [[nodiscard]] static std::string message() { return "move only error"; }
+  [[nodiscard]] static size_t id() { return 2; }
+
+  std::unique_ptr<int> payload_{ std::make_unique<int>(42) };
+  std::vector<anywho::Context> contexts_;
+};
+
+template<int Depth> std::expected<int, CopyCountingError> copyCountingChain()
+{
+  if constexpr (Depth == 0) {
+    return std::unexpected(CopyCountingError{});
+  } else {
+    const int val = ANYWHO(anywho::with_context(copyCountingChain<Depth - 1>(), { "level" }));
+    return val + 1;
+  }
+}
+
+template<int Depth> anywho::ErrorState<CopyCountingError> copyCountingOptionalChain(int &val)
+{
+  if constexpr (Depth == 0) {
+    return CopyCountingError{};
+  } else {
+    ANYWHO_LEGACY(anywho::with_context(copyCountingOptionalChain<Depth - 1>(val), { "level" }));
+    return anywho::NoError;
+  }
+}
+
+anywho::ErrorState<CopyCountingError> copyCountingBridge(int &val)
+{
+  val = ANYWHO_OPT(copyCountingChain<8>());
+  return anywho::NoError;
+}
+
+template<int Depth> std::expected<std::unique_ptr<int>, MoveOnlyError> moveOnlyChain(bool fail)
+{
+  if constexpr (Depth == 0) {
+    if (fail) { return std::unexpected(MoveOnlyError{}); }
+    return std::make_unique<int>(3);
+  } else {
+    auto val = ANYWHO(anywho::with_context(moveOnlyChain<Depth - 1>(fail), { "level" }));
+    ++*val;
+    return val;
+  }
+}
+
+anywho::ErrorState<MoveOnlyError> moveOnlyBridge(bool fail, int &out)
+{
+  auto val = ANYWHO_OPT(moveOnlyChain<4>(fail));
+  out = *val;
+  return anywho::NoError;
+}
+}// namespace
+
+TEST_CASE("errors are moved through the propagation chain", "[direct_return]")
+{
+  CopyCountingError::copies = 0;
+  const auto exp = copyCountingChain<16>();
+  REQUIRE(!exp.has_value());
+  REQUIRE(exp.error().contexts_.size() == 16);
+
+  int val = 0;
+  const auto opt = copyCountingOptionalChain<16>(val);
+  REQUIRE(anywho::has_error(opt));
+  REQUIRE(opt->contexts_.size() == 16);
+
+  const auto bridged = copyCountingBridge(val);
+  REQUIRE(anywho::has_error(bridged));
+  REQUIRE(CopyCountingError::copies == 0);
+}
+
+TEST_CASE("move only errors and values", "[direct_return]")
+{
+  STATIC_REQUIRE(anywho::concepts::Error<MoveOnlyError>);
+  STATIC_REQUIRE(!std::is_copy_constructible_v<MoveOnlyError>);
+
+  const auto value = moveOnlyChain<4>(false);
+  REQUIRE(value.has_value());
+  REQUIRE(**value == 7);
+
+  const auto error = moveOnlyChain<4>(true);
+  REQUIRE(!error.has_value());
+  REQUIRE(error.error().contexts_.size() == 4);
+  REQUIRE(error.error().format() == "move only 42");
+
+  int out = 0;
+  REQUIRE(!anywho::has_error(moveOnlyBridge(false, out)));
+  REQUIRE(out == 7);
+  REQUIRE(anywho::has_error(moveOnlyBridge(true, out)));
+}
+
+TEST_CASE("GenericError is moved, not copied", "[errors]")
+{
+  STATIC_REQUIRE(std::is_nothrow_move_constructible_v<anywho::GenericError>);
+  STATIC_REQUIRE(std::is_nothrow_move_constructible_v<anywho::FixedSizeError<64>>);
+  STATIC_REQUIRE(std::is_nothrow_move_constructible_v<anywho::ErrorFromCode>);
+}
+
+TEST_CASE("format errors and contexts into buffers", "[format]")
+{
+  constexpr int line = 76;
+  const anywho::Context context{ { .message = "abc", .line = line, .file = "tests.cpp" } };
+  REQUIRE(std::format("{}", context) == context.format());
+
+  anywho::GenericError err{};
+  err.consume_context(anywho::Context{ { .message = "abc", .line = line, .file = "tests.cpp" } });
+  err.consume_context(anywho::Context{ { .message = "abc2", .line = line + 1, .file = "tests.cpp" } });
+  REQUIRE(std::format("failed: {}", err) == "failed: " + err.format());
+
+  std::string log;
+  err.format_to(std::back_inserter(log));
+  REQUIRE(log == err.format());
+
+  std::array<char, 32> buffer{};
+  const auto result = std::format_to_n(buffer.data(), buffer.size() - 1, "{}", err);
+  REQUIRE(std::string_view{ buffer.data() } == err.format().substr(0, buffer.size() - 1));
+  REQUIRE(static_cast<std::size_t>(result.size) == err.format().size());
+
+  anywho::FixedSizeError<64> fixed{};
+  fixed.consume_context(anywho::Context{ { .message = "abc", .line = line, .file = "tests.cpp" } });
+  REQUIRE(std::format("{}", fixed) == fixed.format());
+
+  const anywho::ErrorFromCode code{ std::make_error_code(std::errc::invalid_argument) };
+  REQUIRE(std::format("{}", code) == code.format());
+
+  const StaticIdError derived{};
+  REQUIRE(std::format("{}", derived) == "static id error");
+}
+
+TEST_CASE("error codes", "[ErrorFromCode]")
+{
+  SECTION("id from category and value")
+  {
+    STATIC_REQUIRE(anywho::ErrorFromCode::id_of("generic", EINVAL) != anywho::ErrorFromCode::id_of("generic", ENOENT));
+    STATIC_REQUIRE(anywho::ErrorFromCode::id_of("generic", EINVAL) != anywho::ErrorFromCode::id_of("system", EINVAL));
+
+    const anywho::ErrorFromCode code{ std::make_error_code(std::errc::invalid_argument) };
+    REQUIRE(code.id() == anywho::ErrorFromCode::id_of("generic", EINVAL));
+    REQUIRE(code.id() == anywho::ErrorFromCode{ std::error_code{ EINVAL, std::generic_category() } }.id());
+    REQUIRE(code.id() != anywho::ErrorFromCode{ std::error_code{ EINVAL, std::system_category() } }.id());
+  }
+
+  SECTION("message written into the output")
+  {
+    anywho::ErrorFromCode code{ std::make_error_code(std::errc::invalid_argument) };
+    code.consume_context(anywho::Context{ { .message = "parsing", .line = 1, .file = "tests.cpp" } });
+    std::string out;
+    code.message_to(std::back_inserter(out));
+    REQUIRE(out == code.message());
+    REQUIRE(code.format() == code.message() + "::tests.cpp:1 -> parsing");
+    REQUIRE(std::format("{}", code) == code.format());
+  }
+
+  SECTION("reverse bridge")
+  {
+    const std::error_code code = anywho::to_error_code(StaticIdError{});
+    REQUIRE(code);
+    REQUIRE(&code.category() == &anywho::error_category_v<StaticIdError>);
+    REQUIRE(code.value() == anywho::ErrorCategory<StaticIdError>::value_of(anywho::static_id_v<StaticIdError>));
+    REQUIRE(code.message() == "static id error");
+    REQUIRE(std::string_view{ code.category().name() }.find("StaticIdError") != std::string_view::npos);
+    REQUIRE(code == anywho::to_error_code(StaticIdError{}));
+
+    const std::error_code generic = anywho::to_error_code(anywho::GenericError{});
+    REQUIRE(generic.category() != code.category());
+    REQUIRE(generic.message().find(std::to_string(generic.value())) != std::string::npos);
+
+    const auto original = std::make_error_code(std::errc::io_error);
+    REQUIRE(anywho::to_error_code(anywho::ErrorFromCode{ original }) == original);
+  }
+}
+
+namespace {
+// When set, every allocation of the current thread through the global operator new fails.
+constinit thread_local bool fail_allocations = false;
+
+constexpr uint RealtimeErrorSize = 48;
+class RealtimeError final : public anywho::WithStaticId<RealtimeError, anywho::FixedSizeError<RealtimeErrorSize>>
+{
+public:
+  static constexpr std::string_view static_message{ "realtime error" };
+};
+}// namespace
+
+namespace {
+// Returns nullptr on failure, the throwing forms of operator new turn that into std::bad_alloc.
+void *allocate(std::size_t size, std::size_t alignment)
+{
+  if (fail_allocations) { return nullptr; }
+  if (size == 0) { size = 1; }
+  if (alignment <= alignof(std::max_align_t)) { return std::malloc(size); }
+  return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+void *allocate_or_throw(std::size_t size, std::size_t alignment)
+{
+  if (void *ptr = allocate(size, alignment)) { return ptr; }
+  throw std::bad_alloc{};
+}
+
+// Not inlined, otherwise gcc sees free called on memory from operator new wherever a delete is inlined.
+[[gnu::noinline]] void release(void *ptr) noexcept { std::free(ptr); }
+}// namespace
+
+// Every allocation function is replaced, so that memory of all forms of new is released by the matching delete.
+void *operator new(std::size_t size) { return allocate_or_throw(size, alignof(std::max_align_t)); }
+void *operator new[](std::size_t size) { return allocate_or_throw(size, alignof(std::max_align_t)); }
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+  return allocate_or_throw(size, static_cast<std::size_t>(alignment));
+}
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+  return allocate_or_throw(size, static_cast<std::size_t>(alignment));
+}
+void *operator new(std::size_t size, const std::nothrow_t & /*tag*/) noexcept
+{
+  return allocate(size, alignof(std::max_align_t));
+}
+void *operator new[](std::size_t size, const std::nothrow_t & /*tag*/) noexcept
+{
+  return allocate(size, alignof(std::max_align_t));
+}
+void *operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t & /*tag*/) noexcept
+{
+  return allocate(size, static_cast<std::size_t>(alignment));
+}
+void *operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t & /*tag*/) noexcept
+{
+  return allocate(size, static_cast<std::size_t>(alignment));
+}
+void operator delete(void *ptr) noexcept { release(ptr); }
+void operator delete[](void *ptr) noexcept { release(ptr); }
+void operator delete(void *ptr, std::size_t /*size*/) noexcept { release(ptr); }
+void operator delete[](void *ptr, std::size_t /*size*/) noexcept { release(ptr); }
+void operator delete(void *ptr, std::align_val_t /*alignment*/) noexcept { release(ptr); }
+void operator delete[](void *ptr, std::align_val_t /*alignment*/) noexcept { release(ptr); }
+void operator delete(void *ptr, std::size_t /*size*/, std::align_val_t /*alignment*/) noexcept { release(ptr); }
+void operator delete[](void *ptr, std::size_t /*size*/, std::align_val_t /*alignment*/) noexcept { release(ptr); }
+void operator delete(void *ptr, const std::nothrow_t & /*tag*/) noexcept { release(ptr); }
+void operator delete[](void *ptr, const std::nothrow_t & /*tag*/) noexcept { release(ptr); }
+void operator delete(void *ptr, std::align_val_t /*alignment*/, const std::nothrow_t & /*tag*/) noexcept
+{
+  release(ptr);
+}
+void operator delete[](void *ptr, std::align_val_t /*alignment*/, const std::nothrow_t & /*tag*/) noexcept
+{
+  release(ptr);
+}
+
+TEST_CASE("FixedSizeError does not allocate", "[errors]")
+{
+  constexpr int line = 76;
+  using Error = RealtimeError;
+
+  std::array<char, RealtimeErrorSize + 32> buffer{};
+  bool allocated = false;
+  Error copy{};
+  fail_allocations = true;
+  try {
+    Error err{};
+    err.consume_context(anywho::Context{ { .message = "abc", .line = line, .file = "tests.cpp" } });
+    err.consume_context(anywho::Context{ "abc2" });
+    err.consume_context(anywho::Context{ { .message = "abc3", .line = line + 2, .file = "tests.cpp" } });
+    copy = err;
+    const Error moved = std::move(err);
+    buffer[0] = moved.id() == anywho::static_id_v<RealtimeError> ? 'y' : 'n';
+    std::ranges::copy(moved.context_view(), buffer.begin() + 1);
+  } catch (const std::bad_alloc &) {
+    allocated = true;
+  }
+  fail_allocations = false;
+
+  REQUIRE(!allocated);
+  REQUIRE(buffer[0] == 'y');
+  REQUIRE(copy.truncated());
+  REQUIRE(copy.context_view().size() == RealtimeErrorSize - 1);
+  REQUIRE(std::string_view{ buffer.data() + 1 } == copy.context_view());
+  REQUIRE(copy.format() == copy.message() + std::string{ copy.context_view() });
+  REQUIRE(copy.format().starts_with(copy.message() + "::tests.cpp:76 -> abc::"));
+}
+
+TEST_CASE("type erased error formats without allocating", "[any_error]")
+{
+  anywho::Error erased{ RealtimeError{} };
+  erased.consume_context(anywho::Context{ "ctx" });
+  std::array<char, RealtimeErrorSize * 2> buffer{};
+  bool allocated = false;
+  char *end = nullptr;
+  fail_allocations = true;
+  try {
+    end = erased.format_to(buffer.data());
+  } catch (const std::bad_alloc &) {
+    allocated = true;
+  }
+  fail_allocations = false;
+
+  REQUIRE(!allocated);
+  REQUIRE(std::string_view{ buffer.data(), end } == erased.format());
+
+  // Longer than the buffer on the stack, so the output is written in several chunks.
+  anywho::Error chained{ anywho::GenericError{} };
+  constexpr uint contexts = 100;
+  for (uint line = 1; line <= contexts; ++line) { chained.consume_context(numbered(line)); }
+  std::string out;
+  chained.format_to(std::back_inserter(out));
+  REQUIRE(out.size() > 1000);
+  REQUIRE(out == chained.format());
+  REQUIRE(std::format("{}", chained) == out);
+}
+
+TEST_CASE("length aware fixed string", "[FixedString]")
+{
+  static constexpr anywho::FixedString<8> literal{ "abc" };
+  STATIC_REQUIRE(literal.size() == 3);
+  STATIC_REQUIRE(literal.view() == "abc");
+  STATIC_REQUIRE(literal == "abc");
+  STATIC_REQUIRE(!literal.truncated());
+  STATIC_REQUIRE(anywho::FixedString<4>{ "abcdef" }.truncated());
+  STATIC_REQUIRE(anywho::FixedString<4>{ "abcdef" } == "abc");
+  STATIC_REQUIRE(anywho::FixedString<4>{ "abc" } < anywho::FixedString<8>{ "abd" });
+
+  anywho::FixedString<8> str{ "abc" };
+  REQUIRE(str.append("de"));
+  REQUIRE(str == std::string_view{ "abcde" });
+  REQUIRE(!str.append("fghij"));
+  REQUIRE(str.truncated());
+  REQUIRE(str.size() == str.capacity());
+  REQUIRE(std::string_view{ str.c_str() } == "abcdefg");
+
+  const anywho::FixedString<8> copy = str;
+  REQUIRE(copy == str);
+  REQUIRE(copy.truncated());
+  REQUIRE(std::hash<anywho::FixedString<8>>{}(copy) == std::hash<std::string_view>{}("abcdefg"));
+
+  str.clear();
+  REQUIRE(str.empty());
+  REQUIRE(!str.truncated());
+  str += "xy";
+  const std::string_view view = str;
+  REQUIRE(view == "xy");
+  REQUIRE(static_cast<std::string>(str) == "xy");
+}
+
+namespace {
+std::expected<int, anywho::GenericError> failInsideScope() { return std::unexpected(anywho::GenericError{}); }
+
+std::expected<int, anywho::GenericError> processOrder(int order_id)
+{
+  const anywho::ScopedContext guard{ "processing order {}", order_id };
+  auto val = ANYWHO(failInsideScope());
+  auto again = ANYWHO(anywho::with_context(std::expected<int, anywho::GenericError>{ val }, { "again" }));
+  return again;
+}
+
+std::expected<int, anywho::GenericError> processBatch()
+{
+  const anywho::ScopedContext guard{ "processing batch" };
+  return ANYWHO(processOrder(42));
+}
+}// namespace
+
+TEST_CASE("scoped context breadcrumbs", "[ScopedContext]")
+{
+  REQUIRE(anywho::GenericError{}.contexts().empty());
+
+  const auto single = processOrder(42);
+  REQUIRE(!single.has_value());
+  REQUIRE(single.error().contexts().size() == 1);
+  REQUIRE(single.error().contexts()[0].message() == "processing order 42");
+  REQUIRE(single.error().contexts()[0].file().ends_with("tests.cpp"));
+
+  const auto nested = processBatch();
+  REQUIRE(!nested.has_value());
+  REQUIRE(nested.error().contexts().size() == 2);
+  REQUIRE(nested.error().contexts()[0].message() == "processing order 42");
+  REQUIRE(nested.error().contexts()[1].message() == "processing batch");
+
+  // An error created outside of the scope picks the breadcrumbs up when it is propagated inside.
+  std::expected<int, anywho::GenericError> outside = std::unexpected(anywho::GenericError{});
+  {
+    const anywho::ScopedContext guard{ "{}% of {{batch}}", 100 };
+    outside = anywho::with_context(std::move(outside), { "inside" });
+  }
+  REQUIRE(outside.error().contexts().size() == 2);
+  REQUIRE(outside.error().contexts()[1].message() == "100% of {batch}");
+  REQUIRE(anywho::GenericError{}.contexts().empty());
+
+  {
+    const anywho::ScopedContext guard{ "realtime" };
+    fail_allocations = true;
+    const RealtimeError err{};
+    fail_allocations = false;
+    REQUIRE(err.context_view().ends_with(" -> realtime"));
+  }
+}
+
+TEST_CASE("lazy contexts", "[with_context]")
+{
+  int calls = 0;
+  const auto make_context = [&calls] {
+    ++calls;
+    return std::string{ "expensive" };
+  };
+
+  auto happy = anywho::with_context_lazy(std::expected<int, anywho::GenericError>{ 3 }, make_context);
+  REQUIRE(happy.value() == 3);
+  REQUIRE(calls == 0);
+
+  auto failed = anywho::with_context_lazy(
+    std::expected<int, anywho::GenericError>{ std::unexpected(anywho::GenericError{}) }, make_context);
+  REQUIRE(calls == 1);
+  REQUIRE(failed.error().contexts().size() == 1);
+  REQUIRE(failed.error().contexts()[0].message() == "expensive");
+  REQUIRE(failed.error().contexts()[0].file().ends_with("tests.cpp"));
+
+  failed = anywho::with_context_lazy(std::move(failed), [] { return anywho::Context{ "given" }; });
+  REQUIRE(failed.error().contexts()[1].message() == "given");
+
+  const std::string path{ "instrs.txt" };
+  auto formatted = anywho::with_context_fmt(
+    std::expected<int, anywho::GenericError>{ std::unexpected(anywho::GenericError{}) },
+    "Failed to read {} from {}",
+    3,
+    path);
+  REQUIRE(formatted.error().contexts()[0].message() == "Failed to read 3 from instrs.txt");
+  REQUIRE(anywho::with_context_fmt(std::expected<int, anywho::GenericError>{ 3 }, "unused {}", path).value() == 3);
+
+  auto opt = anywho::with_context_lazy(std::optional<anywho::GenericError>{}, make_context);
+  REQUIRE(!anywho::has_error(opt));
+  REQUIRE(calls == 1);
+  opt = anywho::with_context_fmt(std::make_optional(anywho::GenericError{}), "{} {{}}", path);
+  REQUIRE(opt->contexts()[0].message() == "instrs.txt {}");
+  opt = anywho::with_context_fmt(std::move(opt), "literal");
+  REQUIRE(opt->contexts()[1].message() == "literal");
+}
+
+namespace {
+class RegisteredError final : public anywho::WithStaticId<RegisteredError>
+{
+public:
+  static constexpr std::string_view static_message{ "registered error" };
+  static constexpr std::string_view static_name{ "RegisteredError" };
+  static constexpr anywho::Severity severity{ anywho::Severity::warning };
+};
+
+constinit anywho::ErrorDescriptor manual_descriptor{ "ManualError", "manually described error" };
+constinit anywho::ErrorDescriptor duplicate_descriptor{ "DuplicateError", "manually described error" };
+
+class ClashingError final : public anywho::WithStaticId<ClashingError>
+{
+public:
+  static constexpr std::string_view static_message{ "registered error" };
+};
+}// namespace
+
+TEST_CASE("error registry", "[error_registry]")
+{
+  REQUIRE(anywho::error_registry.find(anywho::hash_id("never registered")) == nullptr);
+
+  // Concurrent first use from many threads registers the type exactly once.
+  std::vector<std::thread> threads;
+  std::atomic<int> mismatches{ 0 };
+  constexpr int thread_count = 8;
+  for (int i = 0; i < thread_count; ++i) {
+    threads.emplace_back([&mismatches] {
+      const auto &descriptor = RegisteredError::descriptor();
+      if (anywho::error_registry.find(descriptor.id()) != &descriptor) { ++mismatches; }
+    });
+  }
+  for (auto &el : threads) { el.join(); }
+  REQUIRE(mismatches == 0);
+
+  const auto *found = anywho::error_registry.find(RegisteredError{}.id());
+  REQUIRE(found == &RegisteredError::descriptor());
+  REQUIRE(found->name() == "RegisteredError");
+  REQUIRE(found->message() == "registered error");
+  REQUIRE(found->severity() == anywho::Severity::warning);
+  REQUIRE(anywho::severity_name(found->severity()) == "warning");
+
+  const auto &derived_name = StaticIdError::descriptor();
+  REQUIRE(derived_name.name().ends_with("StaticIdError"));
+  REQUIRE(derived_name.severity() == anywho::Severity::error);
+
+  REQUIRE(anywho::error_registry.add(manual_descriptor));
+  REQUIRE(!anywho::error_registry.add(manual_descriptor));
+  REQUIRE(!anywho::error_registry.add(duplicate_descriptor));
+  REQUIRE(anywho::error_registry.find(anywho::hash_id("manually described error")) == &manual_descriptor);
+
+  int registered = 0;
+  anywho::error_registry.for_each([&registered](const anywho::ErrorDescriptor &) { ++registered; });
+  REQUIRE(registered >= 3);
+
+  const auto collided = [](const anywho::ErrorDescriptor &descriptor) {
+    bool found_collision = false;
+    anywho::error_registry.for_each_collision(
+      [&](const anywho::ErrorDescriptor &el) { found_collision = found_collision || &el == &descriptor; });
+    return found_collision;
+  };
+  REQUIRE(collided(duplicate_descriptor));
+  REQUIRE(!collided(manual_descriptor));
+  REQUIRE(!collided(RegisteredError::descriptor()));
+  // Same message, so the same id as RegisteredError, which was described first.
+  const auto &clashing = ClashingError::descriptor();
+  REQUIRE(collided(clashing));
+  REQUIRE(anywho::error_registry.find(clashing.id()) == &RegisteredError::descriptor());
+  int clashes = 0;
+  anywho::error_registry.for_each_collision([&clashes](const anywho::ErrorDescriptor &) { ++clashes; });
+  REQUIRE(clashes >= 2);
+}
+
+namespace {
+std::expected<int, StaticIdError> concreteFailure(bool fail)
+{
+  if (fail) { return std::unexpected(StaticIdError{}); }
+  return 1;
+}
+
+std::expected<int, anywho::Error> erasedChain(bool fail)
+{
+  const int first = ANYWHO(anywho::with_context(concreteFailure(fail), { "first" }));
+  const auto second = ANYWHO(moveOnlyChain<1>(false));
+  return first + *second;
+}
+}// namespace
+
+TEST_CASE("type erased error", "[Error]")
+{
+  STATIC_REQUIRE(sizeof(anywho::Error) == sizeof(void *));
+  STATIC_REQUIRE(sizeof(std::expected<int, anywho::Error>) == 2 * sizeof(void *));
+  STATIC_REQUIRE(anywho::concepts::Error<anywho::Error>);
+  STATIC_REQUIRE(!std::is_copy_constructible_v<anywho::Error>);
+  STATIC_REQUIRE(std::is_nothrow_move_constructible_v<anywho::Error>);
+
+  REQUIRE(erasedChain(false).value() == 5);
+
+  auto failed = anywho::with_context(erasedChain(true), { "erased" });
+  REQUIRE(!failed.has_value());
+  auto &error = failed.error();
+  REQUIRE(error.id() == anywho::static_id_v<StaticIdError>);
+  REQUIRE(error.message() == "static id error");
+  REQUIRE(error.is<StaticIdError>());
+  REQUIRE(error.is<anywho::GenericError>());
+  REQUIRE(!error.is<anywho::ErrorFromCode>());
+  REQUIRE(error.downcast<anywho::ErrorFromCode>() == nullptr);
+
+  const auto *concrete = std::as_const(error).downcast<StaticIdError>();
+  REQUIRE(concrete != nullptr);
+  REQUIRE(error.downcast<anywho::GenericError>() == concrete);
+  REQUIRE(concrete->contexts().size() == 2);
+  REQUIRE(concrete->contexts()[1].message() == "erased");
+  REQUIRE(error.format() == concrete->format());
+  REQUIRE(std::format("{}", error) == concrete->format());
+
+  const anywho::Error move_only{ MoveOnlyError{} };
+  REQUIRE(move_only.format() == "move only 42");
+
+  anywho::Error in_place{ std::in_place_type<anywho::FixedSizeError<64>> };
+  in_place.consume_context(anywho::Context{ "ctx" });
+  const auto *fixed = in_place.downcast<anywho::FixedSizeError<64>>();
+  REQUIRE(fixed != nullptr);
+  REQUIRE(fixed->context_view().ends_with("ctx"));
+  in_place = std::move(error);
+  REQUIRE(in_place.is<StaticIdError>());
+}
+
+namespace {
+class CountedError final : public anywho::WithStaticId<CountedError>
+{
+public:
+  static constexpr std::string_view static_message{ "counted error" };
+};
+
+template<int Depth> std::expected<int, CountedError> countedChain()
+{
+  if constexpr (Depth == 0) {
+    return std::unexpected(CountedError{});
+  } else {
+    return ANYWHO(anywho::with_context(countedChain<Depth - 1>(), { "level" }));
+  }
+}
+
+/// @brief Creates an error in a thread_local destructor, after the thread handed its metrics shard back
+struct CountsOnThreadExit
+{
+  CountsOnThreadExit() = default;
+  CountsOnThreadExit(const CountsOnThreadExit &) = delete;
+  CountsOnThreadExit(CountsOnThreadExit &&) = delete;
+  CountsOnThreadExit &operator=(const CountsOnThreadExit &) = delete;
+  CountsOnThreadExit &operator=(CountsOnThreadExit &&) = delete;
+  ~CountsOnThreadExit() { static_cast<void>(countedChain<1>()); }
+};
+
+[[maybe_unused]] anywho::metrics::ErrorCount countOf(const anywho::metrics::Snapshot &snapshot, anywho::ErrorId id)
+{
+  const auto found = std::ranges::find(snapshot.errors, id, &anywho::metrics::ErrorCount::id);
+  return found == snapshot.errors.end() ? anywho::metrics::ErrorCount{ id } : *found;
+}
+}// namespace
+
+TEST_CASE("error metrics", "[metrics]")
+{
+  constexpr auto id = anywho::static_id_v<CountedError>;
+#if ANYWHO_ENABLE_METRICS
+  STATIC_REQUIRE(anywho::metrics::enabled);
+  const auto before = anywho::metrics::snapshot();
+  {
+    const auto result = countedChain<3>();
+    REQUIRE(!result.has_value());
+  }
+  const auto after = anywho::metrics::snapshot();
+  REQUIRE(countOf(after, id).created == countOf(before, id).created + 1);
+  REQUIRE(countOf(after, id).contexts == countOf(before, id).contexts + 3);
+  REQUIRE(countOf(after, id).propagated == countOf(before, id).propagated + 3);
+  REQUIRE(after.depth_histogram[3] == before.depth_histogram[3] + 1);
+  REQUIRE(std::ranges::is_sorted(after.errors, {}, &anywho::metrics::ErrorCount::id));
+
+  // Errors without a static id are counted on construction, under their dynamic id once they are first seen.
+  const auto generic_id = anywho::GenericError{}.id();
+  REQUIRE(after.unidentified == before.unidentified);
+  const auto unseen = anywho::metrics::snapshot();
+  static_cast<void>(anywho::FixedSizeError<64>{});
+  const auto handled = anywho::metrics::snapshot();
+  REQUIRE(handled.unidentified == unseen.unidentified + 1);
+  const auto generic = anywho::with_context(
+    std::expected<int, anywho::GenericError>{ std::unexpected(anywho::GenericError{}) }, { "ctx" });
+  const auto seen = anywho::metrics::snapshot();
+  REQUIRE(countOf(seen, generic_id).created == countOf(unseen, generic_id).created + 1);
+  REQUIRE(seen.unidentified == handled.unidentified);
+
+  constexpr int thread_count = 4;
+  constexpr int errors_per_thread = 10;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < thread_count; ++i) {
+    threads.emplace_back([] {
+      for (int j = 0; j < errors_per_thread; ++j) { static_cast<void>(countedChain<1>()); }
+    });
+  }
+  for (auto &el : threads) { el.join(); }
+  const auto threaded = anywho::metrics::snapshot();
+  REQUIRE(countOf(threaded, id).created == countOf(after, id).created + thread_count * errors_per_thread);
+  REQUIRE(threaded.dropped == before.dropped);
+  REQUIRE(threaded.unidentified == seen.unidentified);
+
+  // Constructed before the shard is claimed, hence destroyed after it is handed back.
+  std::thread([] {
+    thread_local const CountsOnThreadExit late{};
+    static_cast<void>(late);
+    static_cast<void>(countedChain<1>());
+  }).join();
+  const auto exited = anywho::metrics::snapshot();
+  REQUIRE(countOf(exited, id).created == countOf(threaded, id).created + 1);
+  REQUIRE(exited.dropped > threaded.dropped);
+#else
+  STATIC_REQUIRE(!anywho::metrics::enabled);
+  STATIC_REQUIRE(std::is_empty_v<anywho::metrics::Probe>);
+  static_cast<void>(countedChain<3>());
+  REQUIRE(anywho::metrics::snapshot().errors.empty());
+  REQUIRE(anywho::metrics::snapshot().unidentified == 0);
+  static_cast<void>(id);
+#endif
+}
+
+namespace {
+class WireError final : public anywho::WithStaticId<WireError>
+{
+public:
+  static constexpr std::string_view static_message{ "wire error" };
+};
+
+anywho::GenericError makeWireChain()
+{
+  constexpr uint line = 10;
+  anywho::GenericError error{};
+  error.consume_context(anywho::Context{ { .message = "open", .line = line, .file = "io.cpp" } });
+  error.consume_context(anywho::Context{ { .message = "parse", .line = line + 1, .file = "parser.cpp" } });
+  error.consume_context(anywho::Context{ { .message = std::string{ "load" }, .line = line + 2, .file = "io.cpp" } });
+  return error;
+}
+}// namespace
+
+TEST_CASE("wire format", "[wire]")
+{
+  namespace wire = anywho::wire;
+  std::array<std::byte, 512> buffer{};
+
+  const auto error = makeWireChain();
+  const auto size = wire::encode(error, buffer);
+  REQUIRE(size.has_value());
+  REQUIRE(*size == wire::encoded_size(error));
+
+  const auto view = wire::decode(std::span{ buffer }.first(*size));
+  REQUIRE(view.has_value());
+  REQUIRE(view->size() == *size);
+  REQUIRE(view->id() == error.id());
+  REQUIRE(view->message() == error.message());
+  REQUIRE(view->contexts().size() == 3);
+  std::vector<std::string> files;
+  for (const auto &el : view->contexts()) { files.emplace_back(el.file); }
+  REQUIRE(files == std::vector<std::string>{ "io.cpp", "parser.cpp", "io.cpp" });
+  REQUIRE((*std::next(view->contexts().begin())).line == 11);
+
+  // Interned files are stored once.
+  const auto once = std::ranges::search(buffer, std::as_bytes(std::span{ std::string_view{ "io.cpp" } }));
+  REQUIRE(!once.empty());
+  REQUIRE(std::ranges::search(std::span{ once.end(), buffer.end() },
+            std::as_bytes(std::span{ std::string_view{ "io.cpp" } }))
+            .empty());
+
+  const auto generic = view->to_error();
+  REQUIRE(generic.format() == error.format());
+  REQUIRE(generic.id() == error.id());
+  REQUIRE(generic.contexts()[1].file() == "parser.cpp");
+  const auto fixed = view->to_error<anywho::FixedSizeError<256>>();
+  REQUIRE(fixed.format() == error.format());
+
+  // FixedSizeError only keeps its contexts as text, which still round trips.
+  const auto fixed_size = wire::encode(fixed, buffer);
+  REQUIRE(fixed_size.has_value());
+  REQUIRE(wire::decode(std::span{ buffer }.first(*fixed_size))->to_error().format() == error.format());
+
+  // Registered messages are sent by id only.
+  const WireError registered{};
+  static_cast<void>(WireError::descriptor());
+  const auto short_size = wire::encode(registered, buffer, wire::MessageEncoding::registered);
+  REQUIRE(short_size.has_value());
+  REQUIRE(*short_size < wire::encoded_size(registered));
+  const auto registered_view = wire::decode(std::span{ buffer }.first(*short_size));
+  REQUIRE(registered_view->message() == "wire error");
+  REQUIRE(registered_view->to_error().id() == anywho::static_id_v<WireError>);
+
+  // Broken input is rejected, never read out of bounds.
+  const auto encoded = std::span{ buffer }.first(*wire::encode(error, buffer));
+  for (std::size_t i = 0; i < encoded.size(); ++i) {
+    REQUIRE(wire::decode(encoded.first(i)).error().get_code() == wire::WireErrc::truncated);
+  }
+  REQUIRE(wire::encode(error, std::span{ buffer }.first(encoded.size() - 1)).error().get_code()
+          == wire::WireErrc::buffer_too_small);
+  auto corrupted = buffer;
+  corrupted[0] = std::byte{ 'X' };
+  REQUIRE(wire::decode(corrupted).error().get_code() == wire::WireErrc::bad_magic);
+  corrupted = buffer;
+  corrupted[4] = std::byte{ 2 };
+  REQUIRE(wire::decode(corrupted).error().get_code() == wire::WireErrc::unsupported_version);
+  corrupted = buffer;
+  corrupted[6] = std::byte{ 0 };// no files, but contexts refer to them
+  REQUIRE(!wire::decode(corrupted).has_value());
+
+  // Crafted headers whose size matches the input, in buffers of exactly that size so that ASan sees any overread.
+  const auto crafted = [](std::uint16_t file_count, std::uint32_t total_size, const std::vector<std::uint32_t> &words) {
+    std::vector<std::byte> out(20 + 4 * words.size());
+    const auto put = [&out](std::size_t at, std::uint64_t value, std::size_t bytes) {
+      for (std::size_t i = 0; i < bytes; ++i) { out[at + i] = static_cast<std::byte>((value >> (8U * i)) & 0xFFU); }
+    };
+    std::ranges::transform(std::string_view{ "AWHO" }, out.begin(), [](char c) { return static_cast<std::byte>(c); });
+    put(4, wire::version, 1);
+    put(6, file_count, 2);
+    put(8, total_size, 4);
+    for (std::size_t i = 0; i < words.size(); ++i) { put(20 + 4 * i, words[i], 4); }
+    return out;
+  };
+  REQUIRE(wire::decode(crafted(1000, 20, {})).error().get_code() == wire::WireErrc::truncated);
+  REQUIRE(wire::decode(crafted(1000, 24, { 0 })).error().get_code() == wire::WireErrc::truncated);
+  REQUIRE(wire::decode(crafted(1, 36, { 0, 1000, 4, 0 })).error().get_code() == wire::WireErrc::malformed);
+  REQUIRE(wire::decode(crafted(0, 8, {})).error().get_code() == wire::WireErrc::malformed);
+  REQUIRE(wire::decode(crafted(0, 28, { 0, 0 })).has_value());
+}
+
+TEST_CASE("async sink", "[AsyncSink]")
+{
+  std::mutex mutex;
+  std::vector<std::string> lines;
+  const auto collect = [&](std::string_view batch) {
+    const std::scoped_lock lock{ mutex };
+    for (std::size_t begin = 0, end = 0; (end = batch.find('\n', begin)) != std::string_view::npos; begin = end + 1) {
+      lines.emplace_back(batch.substr(begin, end - begin));
+    }
+    return true;
+  };
+
+  const auto error = makeWireChain();
+  constexpr int thread_count = 4;
+  constexpr int per_thread = 500;
+  {
+    anywho::BasicAsyncSink<64, 256> sink{ collect, { .overflow = anywho::OverflowPolicy::block } };
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count; ++i) {
+      threads.emplace_back([&sink, &error] {
+        for (int j = 0; j < per_thread; ++j) { sink.submit(error); }
+      });
+    }
+    for (auto &el : threads) { el.join(); }
+    sink.flush();
+
+    const auto stats = sink.stats();
+    REQUIRE(stats.written == thread_count * per_thread);
+    REQUIRE(stats.dropped == 0);
+    const std::scoped_lock lock{ mutex };
+    REQUIRE(lines.size() == thread_count * per_thread);
+    REQUIRE(lines.front() == error.format());
+  }
+
+  SECTION("drop policy counts what does not fit")
+  {
+    std::atomic<bool> release{ false };
+    anywho::BasicAsyncSink<4, 64> sink{ [&release](std::string_view) {
+                                         while (!release) { std::this_thread::yield(); }
+                                         return true;
+                                       },
+      { .idle_sleep = std::chrono::microseconds{ 10 } } };
+    const RealtimeError realtime{};
+    bool queued = true;
+    // Submitting never allocates, while the background thread is stuck writing the ring runs full.
+    fail_allocations = true;
+    for (int i = 0; i < 16; ++i) { queued = sink.submit(realtime) && queued; }
+    fail_allocations = false;
+    release = true;
+
+    REQUIRE(!queued);
+    sink.flush();
+    REQUIRE(!sink.submit(error));// too large for a record
+    sink.flush();
+    const auto stats = sink.stats();
+    REQUIRE(stats.dropped > 0);
+    REQUIRE(stats.oversized == 1);
+    REQUIRE(stats.written + stats.dropped == 16);
+  }
+}
+
+namespace {
+class QuietError final : public anywho::WithStaticId<QuietError>
+{
+public:
+  static constexpr std::string_view static_message{ "quiet error" };
+  static constexpr anywho::StackPolicy stack_policy{ anywho::StackPolicy::never() };
+};
+
+class SampledError final : public anywho::WithStaticId<SampledError, anywho::FixedSizeError<64>>
+{
+public:
+  static constexpr std::string_view static_message{ "sampled error" };
+  static constexpr anywho::StackPolicy stack_policy{ anywho::StackPolicy::sampled(4) };
+};
+}// namespace
+
+// Not in the anonymous namespace, only exported functions can be named in stack traces.
+namespace stack_traces {
+[[gnu::noinline]] anywho::GenericError failDeep() { return anywho::GenericError{}; }
+}// namespace stack_traces
+
+TEST_CASE("stack traces", "[stacktrace]")
+{
+#if ANYWHO_ENABLE_STACKTRACE
+  const auto error = stack_traces::failDeep();
+  REQUIRE(!error.stacktrace().empty());
+  REQUIRE(error.stacktrace().frames().size() <= anywho::StackTrace::max_frames);
+  const std::string trace = error.stacktrace().format();
+  REQUIRE(trace.starts_with("#0 "));
+  REQUIRE(trace.contains("failDeep"));
+  // Symbols are cached, formatting again gives the same.
+  REQUIRE(std::format("{}", error.stacktrace()) == trace);
+  REQUIRE(error.format() == error.message());
+
+  const anywho::GenericError copy = error;
+  REQUIRE(std::ranges::equal(copy.stacktrace().frames(), error.stacktrace().frames()));
+
+  REQUIRE(!anywho::FixedSizeError<64>{}.stacktrace().empty());
+  REQUIRE(!anywho::ErrorFromCode{ std::make_error_code(std::errc::io_error) }.stacktrace().empty());
+  REQUIRE(QuietError{}.stacktrace().empty());
+
+  int captured = 0;
+  constexpr int created = 8;
+  for (int i = 0; i < created; ++i) { captured += SampledError{}.stacktrace().empty() ? 0 : 1; }
+  REQUIRE(captured == created / 4);
+#else
+  STATIC_REQUIRE(std::is_empty_v<anywho::StackTrace>);
+  REQUIRE(stack_traces::failDeep().stacktrace().empty());
+  REQUIRE(SampledError{}.stacktrace().format().empty());
+#endif
+}
+
+namespace {
+std::expected<int, anywho::GenericError> coLeaf(bool fail)
+{
+  if (fail) { return std::unexpected(anywho::GenericError{}); }
+  return 1;
+}
+
+std::expected<int, anywho::GenericError> coChain(int depth, bool fail)
+{
+  if (depth == 0) { co_return co_await coLeaf(fail); }
+  const int val = co_await anywho::with_context(coChain(depth - 1, fail), { "propagating" });
+  co_return val + 1;
+}
+
+std::expected<void, anywho::GenericError> coVoid(bool fail)
+{
+  const auto leaf = coLeaf(fail);
+  co_await leaf;// lvalues are copied
+  co_return;
+}
+
+std::expected<std::unique_ptr<int>, anywho::Error> coMoveOnly(bool fail)
+{
+  // GenericError converts to the type erased Error on the way.
+  const int val = co_await coLeaf(fail);
+  co_return std::make_unique<int>(val);
+}
+
+class CountingFrames final : public anywho::FrameAllocator
+{
+public:
+  void *allocate(std::size_t size) override
+  {
+    ++allocations;
+    return ::operator new(size);
+  }
+  void deallocate(void *ptr, std::size_t /*size*/) noexcept override
+  {
+    ++deallocations;
+    ::operator delete(ptr);
+  }
+
+  int allocations{ 0 };
+  int deallocations{ 0 };
+};
+}// namespace
+
+TEST_CASE("coroutine propagation", "[coroutine]")
+{
+  constexpr int depth = 3;
+  REQUIRE(coChain(depth, false) == depth + 1);
+
+  const auto failed = coChain(depth, true);
+  REQUIRE(!failed.has_value());
+  REQUIRE(failed.error().contexts().size() == depth);
+  REQUIRE(failed.error().format() == coChain(depth, true).error().format());
+
+  REQUIRE(coVoid(false).has_value());
+  REQUIRE(!coVoid(true).has_value());
+
+  const auto moved = coMoveOnly(false);
+  REQUIRE(moved.has_value());
+  REQUIRE(**moved == 1);
+  REQUIRE(coMoveOnly(true).error().is<anywho::GenericError>());
+
+  SECTION("frames come from the allocator of the thread")
+  {
+    CountingFrames frames;
+    {
+      const anywho::ScopedFrameAllocator guard{ frames };
+      REQUIRE(!coChain(depth, true).has_value());
+    }
+    REQUIRE(frames.allocations == depth + 1);
+    REQUIRE(frames.deallocations == frames.allocations);
+
+    // The default arena serves frames without allocating once it exists.
+    REQUIRE(coChain(depth, false).has_value());
+    fail_allocations = true;
+    const bool happy = coChain(depth, false).has_value();
+    fail_allocations = false;
+    REQUIRE(happy);
+
+    anywho::FrameArena tiny{ 64 };
+    const anywho::ScopedFrameAllocator guard{ tiny };
+    REQUIRE(coChain(depth, false) == depth + 1);// frames that do not fit come from the heap
+    REQUIRE(tiny.used() == 0);
+  }
+}
+
+namespace {
+class RowError final : public anywho::WithStaticId<RowError>
+{
+public:
+  static constexpr std::string_view static_message{ "invalid row" };
+};
+
+std::expected<int, RowError> validateRow(int row)
+{
+  if (row % 3 == 0) { return std::unexpected(RowError{}); }
+  return row;
+}
+
+anywho::ErrorList validateRows(int first, int last)
+{
+  anywho::ErrorList errors;
+  for (int row = first; row < last; ++row) {
+    if (auto result = anywho::with_context(validateRow(row), { "while validating" }); !result.has_value()) {
+      errors.push(result.error());
+    }
+  }
+  return errors;
+}
+
+std::expected<int, anywho::ErrorList> validateAll()
+{
+  auto errors = validateRows(0, 4);
+  if (!errors.empty()) { return std::unexpected(std::move(errors)); }
+  return 0;
+}
+
+std::expected<int, anywho::ErrorList> validateAllRaised()
+{
+  ANYWHO(anywho::with_context(validateAll(), { "while loading the table" }));
+  return 0;
+}
+}// namespace
+
+TEST_CASE("error list", "[ErrorList]")
+{
+  static_assert(anywho::concepts::Error<anywho::ErrorList>);
+
+  anywho::ErrorList errors;
+  REQUIRE(errors.empty());
+  REQUIRE(errors.begin() == errors.end());
+  REQUIRE(errors.format() == "0 errors happened");
+
+  anywho::GenericError generic;
+  generic.consume_context(anywho::Context{ { .message = "first", .line = 1, .file = "a.cpp" } });
+  generic.consume_context(anywho::Context{ std::string_view{ "second" }, 2, "b.cpp" });
+  OtherStaticIdError fixed;
+  fixed.consume_context(anywho::Context{ { .message = "fixed", .line = 3, .file = "c.cpp" } });
+  anywho::Error erased{ StaticIdError{} };
+  erased.consume_context(anywho::Context{ { .message = "erased", .line = 4, .file = "d.cpp" } });
+
+  errors.push(generic);
+  errors.push(fixed);
+  errors.push(erased);
+  REQUIRE(errors.size() == 3);
+  REQUIRE(errors.id() == anywho::ErrorList::list_id);
+
+  std::vector<std::string> formatted;
+  for (const auto entry : errors) { formatted.push_back(entry.format()); }
+  REQUIRE(formatted == std::vector<std::string>{ generic.format(), fixed.format(), erased.format() });
+
+  const auto first = *errors.begin();
+  REQUIRE(first.id() == generic.id());
+  REQUIRE(first.context_count() == 2);
+  REQUIRE(first.context(1).file() == "b.cpp");
+  REQUIRE(first.context(1).line() == 2);
+  REQUIRE(first.context(1).message() == "second");
+
+  errors.consume_context(anywho::Context{ { .message = "while checking", .line = 5, .file = "e.cpp" } });
+  REQUIRE(errors.format()
+          == "3 errors happened::e.cpp:5 -> while checking\n  " + generic.format() + "\n  " + fixed.format() + "\n  "
+               + erased.format());
+  REQUIRE(std::format("{}", errors) == errors.format());
+
+  SECTION("contexts are stored once per block")
+  {
+    anywho::ErrorList many;
+    many.push(generic);
+    const std::size_t one = many.memory_used();
+    for (int i = 0; i < 999; ++i) { many.push(generic); }
+    REQUIRE(many.size() == 1000);
+    REQUIRE(many.memory_used() < 1000 * one / 2);
+    REQUIRE(std::ranges::all_of(many, [&](const auto entry) { return entry.format() == generic.format(); }));
+  }
+
+  SECTION("errors larger than a block get their own")
+  {
+    anywho::ErrorList small{ 64 };
+    small.push(generic);
+    small.push(generic);
+    REQUIRE(small.size() == 2);
+    REQUIRE(small.format() == "2 errors happened\n  " + generic.format() + "\n  " + generic.format());
+  }
+
+  SECTION("lists of several threads are merged")
+  {
+    std::vector<anywho::ErrorList> parts(4);
+    {
+      std::vector<std::jthread> workers;
+      for (std::size_t i = 0; i < parts.size(); ++i) {
+        workers.emplace_back([&part = parts[i], i] {
+          part = validateRows(static_cast<int>(i) * 1000, static_cast<int>(i + 1) * 1000);
+        });
+      }
+    }
+
+    anywho::ErrorList merged;
+    merged.consume_context(anywho::Context{ { .message = "merged", .line = 0, .file = "" } });
+    for (auto &part : parts) {
+      const std::size_t before = merged.size();
+      const std::size_t added = part.size();
+      merged.merge(std::move(part));
+      REQUIRE(merged.size() == before + added);
+      REQUIRE(part.empty());
+    }
+    REQUIRE(merged.size() == 1334);
+    merged.push(generic);
+
+    std::size_t count = 0;
+    std::size_t rows = 0;
+    for (const auto entry : merged) {
+      ++count;
+      if (entry.message() == "invalid row" && entry.context(0).message() == "while validating") { ++rows; }
+    }
+    REQUIRE(count == 1335);
+    REQUIRE(rows == 1334);
+    REQUIRE(merged.summary()
+            == "1335 errors happened::merged\n  1334x invalid row\n  1x " + std::string{ generic.message() });
+  }
+
+  SECTION("lists propagate like other errors")
+  {
+    const auto result = validateAllRaised();
+    REQUIRE(!result.has_value());
+    REQUIRE(result.error().size() == 2);
+    REQUIRE(result.error().contexts().size() == 1);
+    REQUIRE(result.error().summary().starts_with("2 errors happened::"));
+    REQUIRE(result.error().summary().ends_with("while loading the table\n  2x invalid row"));
+  }
+}
+
+namespace {
+std::expected<int, RowError> squareRow(int row)
+{
+  if (row % 1000 == 999) { return std::unexpected(RowError{}); }
+  return row * row;
+}
+
+std::expected<void, RowError> checkRow(int row)
+{
+  if (!squareRow(row).has_value()) { return std::unexpected(RowError{}); }
+  return {};
+}
+}// namespace
+
+TEST_CASE("parallel algorithms", "[parallel]")
+{
+  anywho::WorkPool pool{ 3 };
+  const anywho::execution::Parallel par{ .pool = &pool, .chunk_size = 64 };
+  std::vector<int> rows(10000);
+  for (std::size_t i = 0; i < rows.size(); ++i) { rows[i] = static_cast<int>(i % 999); }
+
+  const auto squares = anywho::try_transform(par, rows, squareRow);
+  REQUIRE(squares.has_value());
+  REQUIRE(squares->size() == rows.size());
+  REQUIRE((*squares)[9999] == rows[9999] * rows[9999]);
+  REQUIRE(anywho::try_transform(anywho::execution::seq, rows, squareRow).value() == *squares);
+
+  SECTION("the error of the lowest failing index is kept")
+  {
+    std::vector<int> failing(10000, 1);
+    failing[7000] = 999;
+    failing[4321] = 1999;
+    failing[9000] = 999;
+    std::atomic<std::size_t> calls{ 0 };
+    const auto result = anywho::try_transform(par, failing, [&calls](int row) {
+      calls.fetch_add(1, std::memory_order_relaxed);
+      return anywho::with_context(squareRow(row), anywho::Context{ std::string_view{ std::to_string(row) } });
+    });
+    REQUIRE(!result.has_value());
+    REQUIRE(result.error().contexts().back().message() == "1999");
+    REQUIRE(calls.load() < failing.size());
+
+    const auto sequential = anywho::try_for_each(anywho::execution::seq, failing, squareRow);
+    REQUIRE(!sequential.has_value());
+  }
+
+  SECTION("steps behind the first error are stopped")
+  {
+    // The first step fails once other steps are running, which then wait for their stop token.
+    std::atomic<int> started{ 0 };
+    std::atomic<bool> stopped{ false };
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{ 10 };
+    const auto result = anywho::try_for_each(par, rows, [&](const int &row, const std::stop_token &stop) {
+      if (&row == rows.data()) {
+        while (started.load() == 0 && std::chrono::steady_clock::now() < deadline) { std::this_thread::yield(); }
+        return checkRow(999);
+      }
+      started.fetch_add(1);
+      while (!stop.stop_requested() && std::chrono::steady_clock::now() < deadline) { std::this_thread::yield(); }
+      if (stop.stop_requested()) { stopped = true; }
+      return checkRow(row);
+    });
+    REQUIRE(!result.has_value());
+    REQUIRE(stopped.load());
+  }
+
+  SECTION("collect all errors")
+  {
+    std::vector<int> failing(rows.size());
+    for (std::size_t i = 0; i < failing.size(); ++i) { failing[i] = static_cast<int>(i); }
+    const auto all = anywho::try_transform_all(par, failing, squareRow);
+    REQUIRE(!all.has_value());
+    REQUIRE(all.error().size() == 10);
+    REQUIRE(anywho::try_for_each_all(par, failing, squareRow).error().size() == 10);
+    REQUIRE(anywho::try_for_each_all(anywho::execution::seq, std::vector<int>(10, 1), squareRow).has_value());
+  }
+
+  SECTION("steps may return an ErrorState")
+  {
+    const auto result = anywho::try_for_each(par, rows, [](int row) -> anywho::ErrorState<RowError> {
+      if (row == 998) { return RowError{}; }
+      return anywho::NoError;
+    });
+    REQUIRE(!result.has_value());
+  }
+
+  SECTION("exceptions are rethrown on the calling thread")
+  {
+    REQUIRE_THROWS_AS(anywho::try_for_each(par,
+                        rows,
+                        [](int row) -> std::expected<void, RowError> {
+                          if (row == 500) { throw std::runtime_error{ "boom" }; }
+                          return {};
+                        }),
+      std::runtime_error);
+  }
+
+  SECTION("nested calls run on the calling thread")
+  {
+    const auto nested =
+      anywho::try_transform(par, std::vector<int>(8, 1), [&](int /*row*/) -> std::expected<std::size_t, RowError> {
+        const auto inner = ANYWHO(anywho::try_transform(par, rows, squareRow));
+        return inner.size();
+      });
+    REQUIRE(nested.has_value());
+    REQUIRE((*nested)[0] == rows.size());
+  }
+}
+
+namespace {
+class StorageError : public anywho::WithStaticId<StorageError>
+{
+public:
+  using WithStaticId::WithStaticId;
+  static constexpr std::string_view static_message{ "storage error" };
+};
+
+class DiskFullError final : public anywho::WithStaticId<DiskFullError, StorageError>
+{
+public:
+  static constexpr std::string_view static_message{ "disk full" };
+};
+}// namespace
+
+TEST_CASE("match errors", "[match]")
+{
+  const StaticIdError static_id{};
+  const OtherStaticIdError other{};
+  const anywho::ErrorFromCode from_code{ std::make_error_code(std::errc::timed_out) };
+  const auto describe = [](const anywho::GenericError &error) {
+    return anywho::match(
+      error,
+      [](const StaticIdError &) { return 1; },
+      [](const anywho::ErrorFromCode &code) { return code.get_code().value(); },
+      [] { return 0; });
+  };
+
+  SECTION("GenericError hierarchies")
+  {
+    REQUIRE(describe(static_id) == 1);
+    REQUIRE(describe(from_code) == static_cast<int>(std::errc::timed_out));
+    REQUIRE(describe(anywho::GenericError{}) == 0);
+
+    const anywho::GenericError &base = static_id;
+    REQUIRE(anywho::is<StaticIdError>(base));
+    REQUIRE(anywho::is<anywho::GenericError>(base));
+    REQUIRE(!anywho::is<anywho::ErrorFromCode>(base));
+    REQUIRE(anywho::as<StaticIdError>(base) == &static_id);
+    REQUIRE(anywho::as<anywho::ErrorFromCode>(base) == nullptr);
+    STATIC_REQUIRE(std::is_same_v<decltype(anywho::as<StaticIdError>(base)), const StaticIdError *>);
+  }
+
+  SECTION("FixedSizeError derivatives")
+  {
+    const anywho::FixedSizeError<128> &base = other;
+    REQUIRE(anywho::is<OtherStaticIdError>(base));
+    REQUIRE(anywho::as<OtherStaticIdError>(base) == &other);
+    const RealtimeError realtime{};
+    const anywho::FixedSizeError<RealtimeErrorSize> &realtime_base = realtime;
+    REQUIRE(anywho::match(
+              realtime_base, [](const RealtimeError &) { return true; }, [] { return false; }));
+    REQUIRE(!anywho::is<RealtimeError>(anywho::FixedSizeError<RealtimeErrorSize>{}));
+  }
+
+  SECTION("type erased errors")
+  {
+    anywho::Error erased{ anywho::ErrorFromCode{ std::make_error_code(std::errc::io_error) } };
+    REQUIRE(anywho::is<anywho::ErrorFromCode>(erased));
+    REQUIRE(!anywho::is<StaticIdError>(erased));
+    REQUIRE(anywho::as<anywho::ErrorFromCode>(erased) == erased.downcast<anywho::ErrorFromCode>());
+    REQUIRE(anywho::as<anywho::Error>(erased) == &erased);
+
+    int handled = 0;
+    anywho::match(
+      erased,
+      [&](const StaticIdError &) { handled = 1; },
+      [&](anywho::ErrorFromCode &code) {
+        code.consume_context({ "matched" });
+        handled = 2;
+      });
+    REQUIRE(handled == 2);
+    REQUIRE(erased.downcast<anywho::ErrorFromCode>()->contexts().size() == 1);
+
+    anywho::Error io{ IOError{} };
+    REQUIRE(anywho::match(
+              io, [](const ParseError &) { return 1; }, [](const IOError &) { return 2; }, [] { return 3; })
+            == 2);
+  }
+
+  SECTION("intermediate base classes")
+  {
+    const DiskFullError disk_full{};
+    const anywho::GenericError &base = disk_full;
+    REQUIRE(anywho::is<StorageError>(base));
+    REQUIRE(anywho::is<DiskFullError>(base));
+    REQUIRE(!anywho::is<DiskFullError>(StorageError{}));
+    REQUIRE(anywho::as<StorageError>(base) == &disk_full);
+    REQUIRE(anywho::match(
+              base, [](const StaticIdError &) { return 1; }, [](const StorageError &) { return 2; }, [] { return 3; })
+            == 2);
+    REQUIRE(anywho::derives_from(anywho::type_key_v<DiskFullError>, anywho::type_key_v<anywho::GenericError>));
+#if ANYWHO_ENABLE_METRICS
+    // Counted as the derived type only.
+    const auto before = anywho::metrics::snapshot();
+    static_cast<void>(DiskFullError{});
+    const auto after = anywho::metrics::snapshot();
+    constexpr auto derived_id = anywho::static_id_v<DiskFullError>;
+    constexpr auto base_id = anywho::static_id_v<StorageError>;
+    REQUIRE(countOf(after, derived_id).created == countOf(before, derived_id).created + 1);
+    REQUIRE(countOf(after, base_id).created == countOf(before, base_id).created);
+#endif
+
+    anywho::Error erased{ DiskFullError{} };
+    REQUIRE(anywho::is<StorageError>(erased));
+    REQUIRE(erased.downcast<StorageError>()->message() == "disk full");
+    REQUIRE(anywho::match(
+              erased, [](const anywho::GenericError &error) { return error.message(); }, [] { return std::string{}; })
+            == "disk full");
+    REQUIRE(!anywho::is<anywho::ErrorFromCode>(erased));
+    anywho::Error erased_code{ anywho::ErrorFromCode{ std::make_error_code(std::errc::io_error) } };
+    REQUIRE(erased_code.downcast<anywho::GenericError>() == &*erased_code.downcast<anywho::ErrorFromCode>());
+  }
+
+  SECTION("first handler wins, generic handlers take all errors")
+  {
+    REQUIRE(anywho::match(
+              static_id, [](const anywho::GenericError &) { return 1; }, [](const StaticIdError &) { return 2; })
+            == 1);
+    REQUIRE(anywho::match(
+              IOError{}, [](const ParseError &) { return std::string{}; }, [](const auto &error) {
+                return error.message();
+              })
+            == "IOError");
+    REQUIRE(anywho::type_key_of(IOError{}) == anywho::type_key_v<IOError>);
+    const anywho::FixedSizeError<128> &other_base = other;
+    REQUIRE(anywho::type_key_of(other_base) == anywho::type_key_v<OtherStaticIdError>);
+  }
+}